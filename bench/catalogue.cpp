@@ -0,0 +1,192 @@
+/*
+ * Startup indexing of an archive: files with ensemble members and lead times as sub groups are catalogued by walking
+ * every group of every file with the public listing calls, with one Walk per file, and from the sidecars written by
+ * Catalogue on the first pass. Then the files are indexed with nc_index, and a variable is looked up from a freshly
+ * opened index, as a process start would.
+ *
+ * Usage: catalogue [scratch directory] [files] [members] [steps]
+ */
+
+#include "fminc4.h"
+#include "group.h"
+#include "dimension.h"
+#include "variable.h"
+#include "catalogue.h"
+#include "index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace fminc4;
+
+const char* const kVars[] = {"temperature", "pressure", "humidity", "wind_u", "wind_v"};
+
+// Analysis time of the file is its number in hours from the start of 2024
+void Define(const std::string& thePath, size_t theFile, size_t theMembers, size_t theSteps)
+{
+	nc_group file = Create(thePath);
+	file.AddTextAtt("institution", "fminc4 benchmark");
+	nc_dim time = file.AddDim("time", 1);
+	nc_dim y = file.AddDim("y", 64);
+	nc_dim x = file.AddDim("x", 64);
+
+	nc_var analysis = file.AddVar("time", {time}, NC_DOUBLE);
+	analysis.AddTextAtt("units", "hours since 2024-01-01 00:00:00");
+	analysis.Write(std::vector<double>(1, static_cast<double>(theFile)));
+
+	for(size_t m = 0; m < theMembers; ++m)
+	{
+		nc_group member = file.AddGroup("member" + std::to_string(m));
+		member.AddAtt("realization", static_cast<int>(m));
+
+		for(size_t s = 0; s < theSteps; ++s)
+		{
+			nc_group step = member.AddGroup("step" + std::to_string(s));
+			step.AddAtt("lead_time", static_cast<int>(s * 3600));
+
+			for(const char* name : kVars)
+			{
+				nc_var var = step.AddVar(name, {time, y, x}, NC_FLOAT);
+				var.AddTextAtt("units", "1");
+				var.AddAtt("scale_factor", 1.0);
+			}
+		}
+	}
+}
+
+// Variables found by listing calls group by group, with the shape and attributes an index needs
+size_t List(nc_group theGroup)
+{
+	size_t ret = 0;
+	for(nc_var var : theGroup.ListVars())
+	{
+		if(var.Shape().size() == 3 && !var.ListAtts().empty())
+			++ret;
+	}
+
+	for(const std::string& name : theGroup.ListGroups())
+		ret += List(theGroup.GetGroup(name));
+
+	return ret;
+}
+
+double Seconds(const std::function<size_t()>& theRun, size_t theExpected)
+{
+	auto start = std::chrono::steady_clock::now();
+	const size_t found = theRun();
+	const double ret = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if(found != theExpected)
+		std::cerr << "found " << found << " variables, expected " << theExpected << "\n";
+
+	return ret;
+}
+
+int main(int argc, char** argv)
+{
+	std::string dir = argc > 1 ? argv[1] : "/tmp";
+	size_t files = argc > 2 ? std::atoi(argv[2]) : 200;
+	size_t members = argc > 3 ? std::atoi(argv[3]) : 10;
+	size_t steps = argc > 4 ? std::atoi(argv[4]) : 8;
+
+	std::vector<std::string> paths;
+	for(size_t f = 0; f < files; ++f)
+	{
+		paths.push_back(dir + "/fminc4_bench_catalogue" + std::to_string(f) + ".nc");
+		Define(paths.back(), f, members, steps);
+		Close(paths.back());
+		std::remove((paths.back() + kNcCatalogueSuffix).c_str());
+	}
+
+	const size_t expected = files * members * steps * (sizeof(kVars) / sizeof(kVars[0]));
+	const size_t catalogued = expected + files; // and the time coordinate of each file
+
+	const double listed = Seconds([&]()
+	{
+		size_t n = 0;
+		for(const std::string& path : paths)
+		{
+			n += List(Open(path));
+			Close(path);
+		}
+		return n;
+	}, expected);
+
+	const double walked = Seconds([&]()
+	{
+		size_t n = 0;
+		for(const std::string& path : paths)
+		{
+			n += Open(path).Walk().itsVars.size();
+			Close(path);
+		}
+		return n;
+	}, catalogued);
+
+	// first pass writes the sidecars
+	const double written = Seconds([&]()
+	{
+		size_t n = 0;
+		for(const std::string& path : paths)
+			n += Catalogue(path).itsVars.size();
+		return n;
+	}, catalogued);
+
+	const double loaded = Seconds([&]()
+	{
+		size_t n = 0;
+		for(const std::string& path : paths)
+			n += Catalogue(path).itsVars.size();
+		return n;
+	}, catalogued);
+
+	const std::string indexPath = dir + "/fminc4_bench_catalogue.idx";
+	std::remove(indexPath.c_str());
+
+	const double indexed = Seconds([&]()
+	{
+		nc_index index(indexPath);
+		return index.Update(paths).itsScanned * expected / files;
+	}, expected);
+
+	const double updated = Seconds([&]()
+	{
+		nc_index index(indexPath);
+		return index.Update(paths).itsKept * expected / files;
+	}, expected);
+
+	// files of the first ten hours
+	const size_t kHours = 10;
+	const double epoch = 1704067200; // 2024-01-01 00:00:00 UTC
+
+	const double lookup = Seconds([&]()
+	{
+		nc_index index(indexPath);
+		return index.Files("temperature", epoch, epoch + (kHours - 1) * 3600).size();
+	}, std::min(files, kHours));
+
+	std::cout << "method\tseconds\tfiles/s\n";
+	std::cout << "list\t" << listed << "\t" << files / listed << "\n";
+	std::cout << "walk\t" << walked << "\t" << files / walked << "\n";
+	std::cout << "walk+save\t" << written << "\t" << files / written << "\n";
+	std::cout << "sidecar\t" << loaded << "\t" << files / loaded << "\n";
+	std::cout << "index scan\t" << indexed << "\t" << files / indexed << "\n";
+	std::cout << "index unchanged\t" << updated << "\t" << files / updated << "\n";
+	std::cout << "index lookup\t" << lookup << "\t" << files / lookup << "\n";
+
+	for(const std::string& path : paths)
+	{
+		std::remove(path.c_str());
+		std::remove((path + kNcCatalogueSuffix).c_str());
+	}
+
+	std::remove(indexPath.c_str());
+
+	Finalize();
+
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Read and write throughput of storage layouts on a 4-D (time, level, y, x) grid.
+ * Writes go one field at a time, reads are either whole fields (time slice) or the full series of a small tile (time series).
+ *
+ * Usage: layout [output directory]
+ */
+
+#include "fminc4.h"
+#include "group.h"
+#include "dimension.h"
+#include "variable.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace fminc4;
+
+const size_t kSteps = 24;
+const size_t kLevels = 4;
+const size_t kNy = 256;
+const size_t kNx = 256;
+const size_t kTile = 16;
+
+struct layout
+{
+	std::string itsName;
+	nc_var_options itsOptions;
+};
+
+double Seconds(std::chrono::steady_clock::time_point theStart)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - theStart).count();
+}
+
+int main(int argc, char** argv)
+{
+	std::string dir = argc > 1 ? argv[1] : "/tmp";
+
+	std::vector<layout> layouts(6);
+	layouts[0].itsName = "default";
+	layouts[1].itsName = "slice";
+	layouts[1].itsOptions.itsAccess = kNcAccessTimeSlice;
+	layouts[2].itsName = "series";
+	layouts[2].itsOptions.itsAccess = kNcAccessTimeSeries;
+	layouts[3].itsName = "slice+deflate";
+	layouts[3].itsOptions.itsAccess = kNcAccessTimeSlice;
+	layouts[3].itsOptions.itsDeflateLevel = 1;
+	layouts[3].itsOptions.itsShuffle = true;
+	layouts[4].itsName = "series+deflate";
+	layouts[4].itsOptions.itsAccess = kNcAccessTimeSeries;
+	layouts[4].itsOptions.itsDeflateLevel = 1;
+	layouts[4].itsOptions.itsShuffle = true;
+	layouts[5].itsName = "slice+bitround";
+	layouts[5].itsOptions.itsAccess = kNcAccessTimeSlice;
+	layouts[5].itsOptions.itsDeflateLevel = 1;
+	layouts[5].itsOptions.itsShuffle = true;
+	layouts[5].itsOptions.itsQuantize = kNcQuantizeBitRound;
+	layouts[5].itsOptions.itsQuantizeDigits = 12;
+
+	// smooth synthetic field so compression ratios are realistic
+	std::vector<float> field(kNy * kNx);
+	for(size_t j = 0; j < kNy; ++j)
+		for(size_t i = 0; i < kNx; ++i)
+			field[j * kNx + i] = 273.15f + 10.f * std::sin(j * 0.05f) * std::cos(i * 0.03f);
+
+	const double mbytes = static_cast<double>(kSteps * kLevels * kNy * kNx * sizeof(float)) / (1024 * 1024);
+
+	std::cout << "layout\tsize MB\twrite MB/s\tslice read MB/s\tseries read MB/s\n";
+
+	for(const layout& l : layouts)
+	{
+		const std::string path = dir + "/fminc4_bench_layout.nc";
+
+		auto start = std::chrono::steady_clock::now();
+		{
+			nc_group file = Create(path);
+			nc_dim time = file.AddDim("time", kSteps);
+			nc_dim level = file.AddDim("level", kLevels);
+			nc_dim y = file.AddDim("y", kNy);
+			nc_dim x = file.AddDim("x", kNx);
+			nc_var var = file.AddVar("temperature", {time, level, y, x}, NC_FLOAT, l.itsOptions);
+
+			for(size_t t = 0; t < kSteps; ++t)
+				for(size_t k = 0; k < kLevels; ++k)
+					var.Write(field, {t, k, 0, 0}, {1, 1, kNy, kNx});
+		}
+		Close(path);
+		const double write = Seconds(start);
+
+		struct stat st;
+		stat(path.c_str(), &st);
+
+		double sliceRead, seriesRead;
+		{
+			nc_group file = Open(path);
+			nc_var var = file.GetVar("temperature");
+			std::vector<float> buffer(kNy * kNx);
+
+			start = std::chrono::steady_clock::now();
+			for(size_t t = 0; t < kSteps; ++t)
+				for(size_t k = 0; k < kLevels; ++k)
+					var.Read(buffer.data(), buffer.size(), {t, k, 0, 0}, {1, 1, kNy, kNx});
+			sliceRead = Seconds(start);
+
+			// series of every tile of the lowest level
+			buffer.resize(kSteps * kTile * kTile);
+			start = std::chrono::steady_clock::now();
+			for(size_t j = 0; j < kNy; j += kTile)
+				for(size_t i = 0; i < kNx; i += kTile)
+					var.Read(buffer.data(), buffer.size(), {0, 0, j, i}, {kSteps, 1, kTile, kTile});
+			seriesRead = Seconds(start);
+		}
+		Close(path);
+
+		std::cout << l.itsName << "\t" << st.st_size / (1024. * 1024) << "\t" << mbytes / write << "\t"
+			<< mbytes / sliceRead << "\t" << (mbytes / kLevels) / seriesRead << "\n";
+
+		std::remove(path.c_str());
+	}
+
+	Finalize();
+
+	return 0;
+}
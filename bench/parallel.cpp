@@ -0,0 +1,190 @@
+/*
+ * Aggregate write bandwidth of MPI ranks each writing its own slab of rows of one output grid, with independent and
+ * collective access through CreatePar, against the old way of gathering every slab to rank 0 for a single writer.
+ * Slabs are read back with OpenPar and checked. Needs make MPI=1.
+ *
+ * Usage: mpirun -np 4 parallel [output directory] [ny] [nx] [steps]
+ */
+
+#include "fminc4.h"
+#include "group.h"
+#include "dimension.h"
+#include "variable.h"
+#include <mpi.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace fminc4;
+
+struct slab
+{
+	size_t itsY0; // first row of this rank
+	size_t itsRows;
+};
+
+slab Slab(size_t theNy, int theRank, int theRanks)
+{
+	const size_t rows = theNy / theRanks;
+	const size_t rest = theNy % theRanks;
+
+	slab ret;
+	ret.itsY0 = theRank * rows + std::min<size_t>(theRank, rest);
+	ret.itsRows = rows + (static_cast<size_t>(theRank) < rest ? 1 : 0);
+
+	return ret;
+}
+
+// Value of a grid point, lets every rank check what it reads back
+float Value(size_t t, size_t j, size_t i)
+{
+	return static_cast<float>(t * 1000000 + j * 1000 + i % 1000);
+}
+
+std::vector<float> Rows(const slab& theSlab, size_t theNx, size_t t)
+{
+	std::vector<float> ret(theSlab.itsRows * theNx);
+	for(size_t j = 0; j < theSlab.itsRows; ++j)
+		for(size_t i = 0; i < theNx; ++i)
+			ret[j * theNx + i] = Value(t, theSlab.itsY0 + j, i);
+
+	return ret;
+}
+
+// Seconds of the slowest rank
+double Slowest(double theSeconds)
+{
+	double ret;
+	MPI_Allreduce(&theSeconds, &ret, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	return ret;
+}
+
+double WritePar(const std::string& thePath, size_t theNy, size_t theNx, size_t theSteps, NcParAccess theAccess, int theRank, int theRanks)
+{
+	const slab s = Slab(theNy, theRank, theRanks);
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	const double start = MPI_Wtime();
+	{
+		nc_open_options options;
+		options.itsParAccess = theAccess;
+
+		nc_group file = CreatePar(thePath, MPI_COMM_WORLD, MPI_INFO_NULL, options);
+		nc_dim time = file.AddDim("time", theSteps);
+		nc_dim y = file.AddDim("y", theNy);
+		nc_dim x = file.AddDim("x", theNx);
+		nc_var var = file.AddVar("temperature", {time, y, x}, NC_FLOAT);
+
+		for(size_t t = 0; t < theSteps; ++t)
+			var.Write(Rows(s, theNx, t), {t, s.itsY0, 0}, {1, s.itsRows, theNx});
+	}
+	Close(thePath);
+
+	return Slowest(MPI_Wtime() - start);
+}
+
+double WriteGathered(const std::string& thePath, size_t theNy, size_t theNx, size_t theSteps, int theRank, int theRanks)
+{
+	const slab s = Slab(theNy, theRank, theRanks);
+
+	std::vector<int> counts(theRanks), offsets(theRanks);
+	for(int r = 0; r < theRanks; ++r)
+	{
+		const slab other = Slab(theNy, r, theRanks);
+		counts[r] = static_cast<int>(other.itsRows * theNx);
+		offsets[r] = static_cast<int>(other.itsY0 * theNx);
+	}
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	const double start = MPI_Wtime();
+	{
+		nc_var var;
+		if(theRank == 0)
+		{
+			nc_group file = Create(thePath);
+			nc_dim time = file.AddDim("time", theSteps);
+			nc_dim y = file.AddDim("y", theNy);
+			nc_dim x = file.AddDim("x", theNx);
+			var = file.AddVar("temperature", {time, y, x}, NC_FLOAT);
+		}
+
+		std::vector<float> field(theRank == 0 ? theNy * theNx : 0);
+
+		for(size_t t = 0; t < theSteps; ++t)
+		{
+			std::vector<float> rows = Rows(s, theNx, t);
+			MPI_Gatherv(rows.data(), static_cast<int>(rows.size()), MPI_FLOAT, field.data(), counts.data(), offsets.data(), MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+			if(theRank == 0)
+				var.Write(field, {t, 0, 0}, {1, theNy, theNx});
+		}
+	}
+	if(theRank == 0)
+		Close(thePath);
+
+	return Slowest(MPI_Wtime() - start);
+}
+
+// Every rank reads its own slab back, number of differing time steps over all ranks
+long Check(const std::string& thePath, size_t theNy, size_t theNx, size_t theSteps, int theRank, int theRanks)
+{
+	const slab s = Slab(theNy, theRank, theRanks);
+	long wrong = 0;
+	{
+		nc_var var = OpenPar(thePath, MPI_COMM_WORLD).GetVar("temperature");
+		for(size_t t = 0; t < theSteps; ++t)
+		{
+			std::vector<float> rows = var.Read<float>({t, s.itsY0, 0}, {1, s.itsRows, theNx});
+			if(rows != Rows(s, theNx, t))
+				++wrong;
+		}
+	}
+	Close(thePath);
+
+	long ret;
+	MPI_Allreduce(&wrong, &ret, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+	return ret;
+}
+
+int main(int argc, char** argv)
+{
+	MPI_Init(&argc, &argv);
+
+	int rank, ranks;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+	std::string dir = argc > 1 ? argv[1] : "/tmp";
+	size_t ny = argc > 2 ? std::atoi(argv[2]) : 2048;
+	size_t nx = argc > 3 ? std::atoi(argv[3]) : 2048;
+	size_t steps = argc > 4 ? std::atoi(argv[4]) : 24;
+
+	const std::string path = dir + "/fminc4_bench_parallel.nc";
+	const double mbytes = static_cast<double>(steps * ny * nx * sizeof(float)) / (1024 * 1024);
+
+	const double gathered = WriteGathered(path, ny, nx, steps, rank, ranks);
+	const double independent = WritePar(path, ny, nx, steps, kNcParIndependent, rank, ranks);
+	const long wrongIndependent = Check(path, ny, nx, steps, rank, ranks);
+	const double collective = WritePar(path, ny, nx, steps, kNcParCollective, rank, ranks);
+	const long wrongCollective = Check(path, ny, nx, steps, rank, ranks);
+
+	if(rank == 0)
+	{
+		std::cout << "ranks\tmode\tseconds\tMB/s\n";
+		std::cout << ranks << "\tgather to rank 0\t" << gathered << "\t" << mbytes / gathered << "\n";
+		std::cout << ranks << "\tindependent\t" << independent << "\t" << mbytes / independent << "\n";
+		std::cout << ranks << "\tcollective\t" << collective << "\t" << mbytes / collective << "\n";
+
+		if(wrongIndependent != 0 || wrongCollective != 0)
+			std::cerr << "slabs read back differ from slabs written\n";
+
+		std::remove(path.c_str());
+	}
+
+	Finalize();
+	MPI_Finalize();
+
+	return 0;
+}
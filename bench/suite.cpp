@@ -0,0 +1,279 @@
+/*
+ * Baseline benchmark of the library for comparing releases. Generates synthetic netcdf-4 files in a scratch directory
+ * for every grid size and storage layout and measures create and open latency, metadata lookups, attribute access,
+ * whole variable and hyperslab (one field at a time) write and read throughput, and read scaling over threads.
+ * Every measurement is the best of a few repetitions. Results go to stdout and as CSV to the results file.
+ *
+ * Usage: suite [scratch directory] [results file] [global|file|none]
+ */
+
+#include "fminc4.h"
+#include "group.h"
+#include "dimension.h"
+#include "variable.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace fminc4;
+
+const size_t kSteps = 24;
+const size_t kRepeats = 3;
+const size_t kLookups = 10000;
+const size_t kVars = 8; // variables of the scaling test
+
+struct grid
+{
+	std::string itsName;
+	size_t itsNy;
+	size_t itsNx;
+};
+
+struct layout
+{
+	std::string itsName;
+	nc_var_options itsOptions;
+};
+
+class results
+{
+	public:
+	explicit results(const std::string& thePath) : itsFile(thePath.c_str())
+	{
+		itsFile << "benchmark,grid,layout,threads,value,unit\n";
+		std::cout << "benchmark\tgrid\tlayout\tthreads\tvalue\tunit\n";
+	}
+
+	void Add(const std::string& theBenchmark, const std::string& theGrid, const std::string& theLayout, size_t theThreads, double theValue, const std::string& theUnit)
+	{
+		itsFile << theBenchmark << "," << theGrid << "," << theLayout << "," << theThreads << "," << theValue << "," << theUnit << "\n";
+		std::cout << theBenchmark << "\t" << theGrid << "\t" << theLayout << "\t" << theThreads << "\t" << theValue << "\t" << theUnit << "\n";
+	}
+
+	private:
+	std::ofstream itsFile;
+};
+
+// Shortest of a few runs, least disturbed by the rest of the system
+double Best(const std::function<void()>& theRun)
+{
+	double ret = std::numeric_limits<double>::max();
+
+	for(size_t r = 0; r < kRepeats; ++r)
+	{
+		auto start = std::chrono::steady_clock::now();
+		theRun();
+		ret = std::min(ret, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return ret;
+}
+
+// Smooth synthetic field so that compression ratios are realistic, shifted by its index so that fields differ
+std::vector<float> Field(const grid& theGrid, size_t theIndex)
+{
+	std::vector<float> ret(theGrid.itsNy * theGrid.itsNx);
+	for(size_t j = 0; j < theGrid.itsNy; ++j)
+		for(size_t i = 0; i < theGrid.itsNx; ++i)
+			ret[j * theGrid.itsNx + i] = 273.15f + static_cast<float>(theIndex) + 10.f * std::sin(j * 0.05f) * std::cos(i * 0.03f);
+
+	return ret;
+}
+
+// File of given number of (time, y, x) float variables with a few attributes each, variables left empty
+void Define(const std::string& thePath, const grid& theGrid, const layout& theLayout, size_t theVars)
+{
+	nc_group file = Create(thePath);
+	nc_dim time = file.AddDim("time", kSteps);
+	nc_dim y = file.AddDim("y", theGrid.itsNy);
+	nc_dim x = file.AddDim("x", theGrid.itsNx);
+
+	for(size_t v = 0; v < theVars; ++v)
+	{
+		nc_var var = file.AddVar("var" + std::to_string(v), {time, y, x}, NC_FLOAT, theLayout.itsOptions);
+		var.AddAtt("scale_factor", 1.0);
+		var.AddAtt("add_offset", 0.0);
+		var.AddTextAtt("units", "K");
+	}
+}
+
+void Run(results& theResults, const std::string& theDir, const grid& theGrid, const layout& theLayout)
+{
+	const std::string path = theDir + "/fminc4_bench_suite.nc";
+	const std::string& g = theGrid.itsName;
+	const std::string& l = theLayout.itsName;
+	const size_t field = theGrid.itsNy * theGrid.itsNx;
+	const double mbytes = static_cast<double>(kSteps * field * sizeof(float)) / (1024 * 1024);
+
+	std::vector<std::vector<float>> fields;
+	std::vector<float> whole;
+	for(size_t t = 0; t < kSteps; ++t)
+	{
+		fields.push_back(Field(theGrid, t));
+		whole.insert(whole.end(), fields.back().begin(), fields.back().end());
+	}
+
+	theResults.Add("create", g, l, 1, 1000 * Best([&]()
+	{
+		Define(path, theGrid, theLayout, 1);
+		Close(path);
+	}), "ms");
+
+	theResults.Add("write_whole", g, l, 1, mbytes / Best([&]()
+	{
+		Define(path, theGrid, theLayout, 1);
+		Open(path).GetVar("var0").Write(whole);
+		Close(path);
+	}), "MB/s");
+
+	theResults.Add("write_field", g, l, 1, mbytes / Best([&]()
+	{
+		Define(path, theGrid, theLayout, 1);
+		{
+			nc_var var = Open(path).GetVar("var0");
+			for(size_t t = 0; t < kSteps; ++t)
+				var.Write(fields[t], {t, 0, 0}, {1, theGrid.itsNy, theGrid.itsNx});
+		}
+		Close(path);
+	}), "MB/s");
+
+	theResults.Add("open", g, l, 1, 1000 * Best([&]()
+	{
+		Open(path);
+		Close(path);
+	}), "ms");
+
+	nc_group file = Open(path);
+	nc_var var = file.GetVar("var0");
+
+	theResults.Add("metadata_lookup", g, l, 1, 1e6 * Best([&]()
+	{
+		size_t n = 0;
+		for(size_t i = 0; i < kLookups; ++i)
+			n += file.GetVar("var0").Shape().size() + var.ListAtts().size();
+		if(n == 0)
+			std::cerr << "no metadata\n";
+	}) / kLookups, "us/op");
+
+	theResults.Add("attribute_get", g, l, 1, 1e6 * Best([&]()
+	{
+		double sum = 0;
+		for(size_t i = 0; i < kLookups; ++i)
+			sum += var.GetAtt<double>("scale_factor")[0];
+		if(sum != kLookups)
+			std::cerr << "unexpected attribute value\n";
+	}) / kLookups, "us/op");
+
+	std::vector<float> buffer(whole.size());
+
+	theResults.Add("read_whole", g, l, 1, mbytes / Best([&]()
+	{
+		var.Read(buffer.data(), buffer.size());
+	}), "MB/s");
+
+	if(buffer != whole)
+		std::cerr << "whole variable read differs from data written: " << g << " " << l << "\n";
+
+	// each field into its own place, so that a field read from the wrong step shows
+	std::fill(buffer.begin(), buffer.end(), 0.f);
+
+	theResults.Add("read_field", g, l, 1, mbytes / Best([&]()
+	{
+		for(size_t t = 0; t < kSteps; ++t)
+			var.Read(buffer.data() + t * field, field, {t, 0, 0}, {1, theGrid.itsNy, theGrid.itsNx});
+	}), "MB/s");
+
+	for(size_t t = 0; t < kSteps; ++t)
+	{
+		if(!std::equal(fields[t].begin(), fields[t].end(), buffer.begin() + t * field))
+			std::cerr << "field " << t << " read differs from field written: " << g << " " << l << "\n";
+	}
+
+	Close(path);
+	std::remove(path.c_str());
+}
+
+// Whole variables of one file read in parallel with growing number of workers
+void Scaling(results& theResults, const std::string& theDir, const grid& theGrid, const layout& theLayout, size_t theMaxThreads)
+{
+	const std::string path = theDir + "/fminc4_bench_suite_scaling.nc";
+	const size_t field = theGrid.itsNy * theGrid.itsNx;
+	const double mbytes = static_cast<double>(kVars * kSteps * field * sizeof(float)) / (1024 * 1024);
+
+	std::vector<std::string> names;
+	Define(path, theGrid, theLayout, kVars);
+	{
+		nc_group file = Open(path);
+		for(size_t v = 0; v < kVars; ++v)
+		{
+			names.push_back("var" + std::to_string(v));
+			nc_var var = file.GetVar(names.back());
+			for(size_t t = 0; t < kSteps; ++t)
+				var.Write(Field(theGrid, t), {t, 0, 0}, {1, theGrid.itsNy, theGrid.itsNx});
+		}
+	}
+	Close(path);
+
+	{
+		nc_group file = Open(path);
+		std::vector<std::vector<float>> data;
+
+		for(size_t n = 1; n <= theMaxThreads; n *= 2)
+		{
+			theResults.Add("read_many", theGrid.itsName, theLayout.itsName, n, mbytes / Best([&]()
+			{
+				file.ReadMany(names, data, n);
+			}), "MB/s");
+		}
+	}
+
+	Close(path);
+	std::remove(path.c_str());
+}
+
+int main(int argc, char** argv)
+{
+	std::string dir = argc > 1 ? argv[1] : "/tmp";
+	std::string out = argc > 2 ? argv[2] : "bench/results.csv";
+	std::string mode = argc > 3 ? argv[3] : "global";
+
+	// read scaling needs a lock mode other than global, and a thread-safe library for those
+	if(mode == "file")
+		LockMode(kNcLockFile);
+	else if(mode == "none")
+		LockMode(kNcLockNone);
+	else
+		LockMode(kNcLockGlobal);
+
+	std::vector<grid> grids = { {"64x64", 64, 64}, {"512x512", 512, 512}, {"1024x1024", 1024, 1024} };
+
+	std::vector<layout> layouts(3);
+	layouts[0].itsName = "default";
+	layouts[1].itsName = "slice";
+	layouts[1].itsOptions.itsAccess = kNcAccessTimeSlice;
+	layouts[2].itsName = "slice+deflate";
+	layouts[2].itsOptions.itsAccess = kNcAccessTimeSlice;
+	layouts[2].itsOptions.itsDeflateLevel = 1;
+	layouts[2].itsOptions.itsShuffle = true;
+
+	results res(out);
+
+	for(const grid& g : grids)
+		for(const layout& l : layouts)
+			Run(res, dir, g, l);
+
+	const size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	for(const layout& l : layouts)
+		Scaling(res, dir, grids[1], l, maxThreads);
+
+	Finalize();
+
+	return 0;
+}
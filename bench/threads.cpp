@@ -0,0 +1,90 @@
+/*
+ * Write throughput as a function of writer threads.
+ * Every thread creates its own file and writes a sequence of time steps into it,
+ * which is the access pattern of the post-processing jobs writing many forecast files at once.
+ *
+ * Usage: threads [global|file|none] [max threads] [output directory]
+ */
+
+#include "fminc4.h"
+#include "group.h"
+#include "dimension.h"
+#include "variable.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace fminc4;
+
+const size_t kSteps = 24;
+const size_t kNy = 256;
+const size_t kNx = 256;
+
+void WriteFile(const std::string& path)
+{
+	{
+		nc_group file = Create(path);
+
+		nc_dim time = file.AddDim("time", kSteps);
+		nc_dim y = file.AddDim("y", kNy);
+		nc_dim x = file.AddDim("x", kNx);
+		nc_var var = file.AddVar("temperature", {time, y, x}, NC_FLOAT);
+
+		std::vector<float> data(kNy * kNx, 273.15f);
+
+		for(size_t t = 0; t < kSteps; ++t)
+		{
+			var.Write(data, {t, 0, 0}, {1, kNy, kNx});
+		}
+	}
+
+	// all handles are released, file is closed here
+	Close(path);
+}
+
+int main(int argc, char** argv)
+{
+	std::string mode = argc > 1 ? argv[1] : "global";
+	size_t maxThreads = argc > 2 ? std::atoi(argv[2]) : std::thread::hardware_concurrency();
+	std::string dir = argc > 3 ? argv[3] : "/tmp";
+
+	if(mode == "file")
+		LockMode(kNcLockFile);
+	else if(mode == "none")
+		LockMode(kNcLockNone);
+	else
+		LockMode(kNcLockGlobal);
+
+	const double mbytes = static_cast<double>(kSteps * kNy * kNx * sizeof(float)) / (1024 * 1024);
+
+	std::cout << "lock mode: " << mode << "\n";
+	std::cout << "threads\tseconds\tMB/s\n";
+
+	for(size_t n = 1; n <= maxThreads; n *= 2)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> writers;
+		for(size_t i = 0; i < n; ++i)
+		{
+			std::string path = dir + "/fminc4_bench_threads_" + std::to_string(i) + ".nc";
+			writers.emplace_back(WriteFile, path);
+		}
+		for(auto& t : writers)
+			t.join();
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << n << "\t" << elapsed.count() << "\t" << (mbytes * n) / elapsed.count() << "\n";
+	}
+
+	Finalize();
+
+	for(size_t i = 0; i < maxThreads; ++i)
+		std::remove((dir + "/fminc4_bench_threads_" + std::to_string(i) + ".nc").c_str());
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Unpacking of CF packed short data: vectorized kernel against the scalar reference,
+ * and a whole field read with ReadUnpacked against Read<short> followed by a separate unpack loop.
+ * Build the library and this program with optimization (CXXFLAGS="-std=c++11 -O2") for meaningful numbers.
+ *
+ * Usage: unpack [output directory]
+ */
+
+#include "fminc4.h"
+#include "group.h"
+#include "dimension.h"
+#include "variable.h"
+#include "packing.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace fminc4;
+
+const size_t kValues = 16 * 1024 * 1024;
+const size_t kRounds = 10;
+const size_t kNy = 1069;
+const size_t kNx = 949;
+const size_t kSteps = 24;
+
+double Seconds(std::chrono::steady_clock::time_point theStart)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - theStart).count();
+}
+
+// Results must match the reference bit for bit, NaN included
+template<typename T>
+bool Same(const std::vector<T>& theA, const std::vector<T>& theB)
+{
+	return theA.size() == theB.size() && std::memcmp(theA.data(), theB.data(), theA.size() * sizeof(T)) == 0;
+}
+
+template<typename T>
+void Kernels(const std::vector<short>& thePacked, const nc_packing& thePacking, const char* theName)
+{
+	std::vector<T> reference(thePacked.size()), vectorized(thePacked.size());
+	const double mbytes = static_cast<double>(kRounds * thePacked.size() * (sizeof(short) + sizeof(T))) / (1024 * 1024);
+
+	auto start = std::chrono::steady_clock::now();
+	for(size_t r = 0; r < kRounds; ++r)
+		UnpackScalar(thePacked.data(), thePacked.size(), reference.data(), thePacking);
+	const double scalar = Seconds(start);
+
+	start = std::chrono::steady_clock::now();
+	for(size_t r = 0; r < kRounds; ++r)
+		Unpack(thePacked.data(), thePacked.size(), vectorized.data(), thePacking);
+	const double kernel = Seconds(start);
+
+	std::cout << theName << "\t" << mbytes / scalar << "\t" << mbytes / kernel << "\t" << scalar / kernel << "\t"
+		<< (Same(reference, vectorized) ? "yes" : "NO") << "\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string dir = argc > 1 ? argv[1] : "/tmp";
+
+	nc_packing packing;
+	packing.itsScale = 0.01;
+	packing.itsOffset = 273.15;
+	packing.itsHasFill = true;
+	packing.itsFill = -32767;
+
+	// smooth field with a sprinkling of missing values
+	std::vector<short> packed(kValues);
+	for(size_t i = 0; i < kValues; ++i)
+		packed[i] = i % 997 == 0 ? -32767 : static_cast<short>(3000 * std::sin(i * 0.001));
+
+	std::cout << "kernel: " << UnpackKernel() << "\n";
+	std::cout << "type\tscalar MB/s\tkernel MB/s\tspeedup\tidentical\n";
+
+	Kernels<float>(packed, packing, "float");
+	Kernels<double>(packed, packing, "double");
+
+	// whole fields from a file
+	const std::string path = dir + "/fminc4_bench_unpack.nc";
+	{
+		nc_group file = Create(path);
+		nc_dim time = file.AddDim("time", kSteps);
+		nc_dim y = file.AddDim("y", kNy);
+		nc_dim x = file.AddDim("x", kNx);
+		nc_var var = file.AddVar("temperature", {time, y, x}, NC_SHORT);
+		var.AddAtt("scale_factor", packing.itsScale);
+		var.AddAtt("add_offset", packing.itsOffset);
+		var.AddAtt("_FillValue", static_cast<short>(packing.itsFill));
+
+		std::vector<float> field(kNy * kNx);
+		for(size_t i = 0; i < field.size(); ++i)
+			field[i] = i % 997 == 0 ? NAN : 273.15f + 30.f * std::sin(i * 0.001f);
+
+		for(size_t t = 0; t < kSteps; ++t)
+			var.WritePacked(field.data(), field.size(), {t, 0, 0}, {1, kNy, kNx});
+	}
+	Close(path);
+
+	{
+		nc_group file = Open(path);
+		nc_var var = file.GetVar("temperature");
+
+		std::vector<short> raw(kNy * kNx);
+		std::vector<float> twoPass(kNy * kNx), onePass(kNy * kNx);
+
+		auto start = std::chrono::steady_clock::now();
+		for(size_t t = 0; t < kSteps; ++t)
+		{
+			var.Read(raw.data(), raw.size(), {t, 0, 0}, {1, kNy, kNx});
+			const nc_packing p = var.Packing();
+			UnpackScalar(raw.data(), raw.size(), twoPass.data(), p);
+		}
+		const double separate = Seconds(start);
+
+		start = std::chrono::steady_clock::now();
+		for(size_t t = 0; t < kSteps; ++t)
+			var.ReadUnpacked(onePass.data(), onePass.size(), {t, 0, 0}, {1, kNy, kNx});
+		const double fused = Seconds(start);
+
+		std::cout << "read + unpack loop " << separate * 1000 / kSteps << " ms/field, ReadUnpacked " << fused * 1000 / kSteps
+			<< " ms/field, identical " << (Same(twoPass, onePass) ? "yes" : "NO") << "\n";
+	}
+	Close(path);
+	std::remove(path.c_str());
+
+	Finalize();
+
+	return 0;
+}
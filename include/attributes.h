@@ -0,0 +1,60 @@
+#ifndef ATTRIBUTES_H
+#define ATTRIBUTES_H
+
+#include "schema.h"
+#include "error.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <netcdf.h>
+
+namespace fminc4
+{
+
+struct nc_file;
+
+// Attribute of a variable, or of the group with NC_GLOBAL, with one nc_inq_att and one read. Caller holds the lock.
+// Returns netcdf status, NC_EBADTYPE for attributes of user defined types.
+int ReadAtt(int theNcId, int theVarId, const std::string& theName, nc_att_schema& theAtt);
+
+// Write attribute as described, caller holds the lock
+int WriteAtt(int theNcId, int theVarId, const nc_att_schema& theAtt);
+
+// Values of attribute converted to T. Numbers convert between numeric types, strings are read from NC_CHAR
+// (one string, trailing null characters dropped) and NC_STRING. Returns NC_ECHAR between text and numbers and
+// NC_ERANGE if a value does not fit in T (NaN in integer types).
+template<typename T>
+int ConvertAtt(const nc_att_schema&, std::vector<T>&);
+
+template<>
+int ConvertAtt(const nc_att_schema&, std::vector<std::string>&);
+
+// Attribute values converted to T, decoded attribute is kept in the cache of the file. Failures are returned, not thrown.
+// Must not be called while holding the lock of the file.
+template<typename T>
+nc_result<std::vector<T>> AttValues(nc_file&, int theNcId, int theVarId, const std::string& theName);
+
+/*
+ * Decoded attributes of one file by group, variable and name, so that repeated reads of the same attribute need
+ * no library calls. Emptied by nc_file::Invalidate after any define mode change.
+ */
+
+class nc_att_cache
+{
+	public:
+	std::shared_ptr<const nc_att_schema> Find(int theNcId, int theVarId, const std::string& theName) const; // nullptr if not cached
+	void Insert(int theNcId, int theVarId, std::shared_ptr<const nc_att_schema> theAtt);
+	void Clear();
+
+	private:
+	typedef std::tuple<int, int, std::string> key; // group id, variable id, name
+
+	mutable std::mutex itsMutex;
+	std::map<key, std::shared_ptr<const nc_att_schema>> itsAtts;
+};
+
+} // end namespace fminc4
+#endif /* ATTRIBUTES_H */
@@ -0,0 +1,76 @@
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <netcdf.h>
+
+namespace fminc4
+{
+
+struct nc_file;
+
+/*
+ * LRU cache of decoded hyperslab blocks of one file. Variables are divided into blocks along their chunk shape
+ * (or a field sized block for contiguous variables) and small reads are served by copying from cached blocks.
+ * Blocks are kept in the external type of the variable.
+ */
+
+class nc_block_cache
+{
+	public:
+	nc_block_cache(nc_file&, size_t theCapacity);
+
+	// Copy subarray of variable of given current shape to memory holding elements of the variable's own type. Returns netcdf status.
+	// Requests larger than a block are not cached and return NC_EINVAL so that caller reads them directly.
+	int Read(int theNcId, int theVarId, const std::vector<size_t>& theShape, const std::vector<size_t>& theStart, const std::vector<size_t>& theCount, void* theData);
+
+	// Drop blocks of a variable after it has been written to
+	void Erase(int theNcId, int theVarId);
+
+	// Drop all blocks and layouts after the file was redefined
+	void Clear();
+
+	private:
+	struct layout
+	{
+		nc_type itsType;
+		size_t itsElementSize;
+		std::vector<size_t> itsBlock;
+	};
+
+	struct block
+	{
+		int itsNcId;
+		int itsVarId;
+		std::vector<size_t> itsIndex;
+		std::vector<size_t> itsStart;
+		std::vector<size_t> itsCount;
+		std::vector<unsigned char> itsData;
+	};
+
+	typedef std::pair<int, int> var_key; // group id, variable id
+	typedef std::list<block>::iterator entry;
+
+	// Library is called without holding itsMutex, the lock is released and taken again
+	int Layout(std::unique_lock<std::mutex>&, int theNcId, int theVarId, const std::vector<size_t>& theShape, layout& theLayout);
+	const block* Fetch(std::unique_lock<std::mutex>&, int theNcId, int theVarId, const layout&, const std::vector<size_t>& theIndex, const std::vector<size_t>& theShape, block& theScratch, int& theStatus);
+	void Drop(entry);
+	static std::string Key(int theNcId, int theVarId, const std::vector<size_t>& theIndex);
+
+	nc_file& itsFile;
+	const size_t itsCapacity;
+	size_t itsSize;
+	size_t itsGeneration; // changed by Erase and Clear, blocks read meanwhile are not cached
+	std::mutex itsMutex;
+	std::map<var_key, layout> itsLayouts;
+	std::list<block> itsBlocks; // most recently used first
+	std::unordered_map<std::string, entry> itsIndex;
+};
+
+} // end namespace fminc4
+#endif /* BLOCKCACHE_H */
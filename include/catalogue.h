@@ -0,0 +1,104 @@
+#ifndef CATALOGUE_H
+#define CATALOGUE_H
+
+#include "common.h"
+#include "schema.h"
+#include "error.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fminc4
+{
+
+struct nc_file;
+
+struct nc_catalogue_dim
+{
+	std::string itsName;
+	size_t itsLength; // current length, also for unlimited dimensions
+	bool itsUnlimited;
+};
+
+struct nc_catalogue_var
+{
+	std::string itsName;
+	nc_type itsType;
+	size_t itsFirstDim; // dimensions in itsVarDims
+	size_t itsDims;
+	size_t itsFirstAtt; // attributes in itsAtts
+	size_t itsAtts;
+};
+
+struct nc_catalogue_group
+{
+	std::string itsName; // "/" for root group
+	std::string itsPath; // full path, e.g. /member1/step06
+	int itsParent; // index of parent group, -1 for the walked group
+	size_t itsNext; // index of the first group after this group and its sub groups
+	size_t itsFirstDim; // dimensions defined in the group, in itsDims
+	size_t itsDims;
+	size_t itsFirstVar; // in itsVars
+	size_t itsVars;
+	size_t itsFirstAtt; // group attributes in itsAtts
+	size_t itsAtts;
+};
+
+class nc_catalogue;
+
+// Callbacks of nc_catalogue::Walk, groups come depth first in definition order before their contents
+struct nc_catalogue_visitor
+{
+	virtual ~nc_catalogue_visitor() {}
+
+	virtual bool Group(const nc_catalogue&, const nc_catalogue_group&) { return true; } // false skips the group and its sub groups
+	virtual void Dim(const nc_catalogue&, const nc_catalogue_group&, const nc_catalogue_dim&) {}
+	virtual void Var(const nc_catalogue&, const nc_catalogue_group&, const nc_catalogue_var&) {}
+	virtual void Att(const nc_catalogue&, const nc_catalogue_group&, const nc_catalogue_var*, const nc_att_schema&) {} // nullptr for group attributes
+};
+
+/*
+ * Flat description of a group tree: groups, dimensions, variables and attributes with their values each in one
+ * array, records refer to each other by index. Built by nc_group::Walk holding the lock of the file once, and saved
+ * to and loaded from a binary sidecar file so that indexing many files does not need to open them again.
+ */
+
+class nc_catalogue
+{
+	public:
+	nc_catalogue();
+
+	void Walk(nc_catalogue_visitor&) const;
+
+	// Lookups return -1 if not found
+	int Group(const std::string& thePath) const;
+	int Var(int theGroup, const std::string& theName) const;
+
+	const nc_catalogue_dim& VarDim(const nc_catalogue_var&, size_t theIndex) const;
+	std::vector<size_t> Shape(const nc_catalogue_var&) const;
+
+	// Throws nc_error carrying errno if the sidecar cannot be written. Written to a temporary file and renamed.
+	void Save(const std::string& thePath) const;
+
+	// NC_ENOTNC if the file is not a catalogue of this version, errno if it cannot be read
+	static nc_result<nc_catalogue> Load(const std::string& thePath);
+
+	std::vector<nc_catalogue_group> itsGroups; // depth first, walked group first
+	std::vector<nc_catalogue_dim> itsDims; // by group, then dimensions of parents of the walked group that variables use
+	std::vector<size_t> itsVarDims; // indexes to itsDims, by variable
+	std::vector<nc_catalogue_var> itsVars; // by group, in variable id order
+	std::vector<nc_att_schema> itsAtts; // by group, group attributes first followed by those of each variable
+
+	// Size and modification time (ns) of the file the catalogue describes, set by Catalogue. 0 if not known.
+	uint64_t itsSourceSize;
+	uint64_t itsSourceTime;
+};
+
+// Walk a group of a file, nc_group::Walk. Must not be called while holding the lock of the file.
+nc_catalogue WalkGroup(nc_file&, int theGroupId);
+
+// Sidecar of a file is the path of the file with this suffix, see Catalogue in fminc4.h
+extern const char* const kNcCatalogueSuffix;
+
+} // end namespace fminc4
+#endif /* CATALOGUE_H */
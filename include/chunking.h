@@ -0,0 +1,35 @@
+#ifndef CHUNKING_H
+#define CHUNKING_H
+
+#include "common.h"
+#include <vector>
+
+namespace fminc4
+{
+
+// Storage layout and compression of a new variable
+struct nc_var_options
+{
+	nc_var_options() : itsAccess(kNcAccessDefault), itsDeflateLevel(0), itsShuffle(false), itsZstdLevel(0), itsQuantize(kNcQuantizeNone), itsQuantizeDigits(0) {}
+
+	std::vector<size_t> itsChunks; // explicit chunk shape, overrides itsAccess
+	NcAccessPattern itsAccess;
+	int itsDeflateLevel; // 1-9, 0 disables deflate
+	bool itsShuffle;
+	int itsZstdLevel; // 0 disables zstd, needs libnetcdf built with zstd
+	NcQuantize itsQuantize; // float and double variables only, needs libnetcdf 4.8.1 or later
+	int itsQuantizeDigits; // significant decimal digits (BitGroom, GranularBR) or bits (BitRound)
+};
+
+// Chunk shape for a variable of given dimension lengths and element size. Zero length (unlimited) dimensions count as growing along time.
+std::vector<size_t> ChunkShape(const std::vector<size_t>&, size_t, NcAccessPattern);
+
+// Block shape reads of an existing variable are best aligned to: its chunk shape, or a field sized block for contiguous variables.
+// Caller must hold the lock of the file.
+int StorageBlock(int theNcId, int theVarId, const std::vector<size_t>& theShape, size_t theElementSize, std::vector<size_t>& theBlock);
+
+// Apply storage options to a variable in define mode. Caller must hold the lock of the file.
+int DefineStorage(int, int, const std::vector<size_t>&, nc_type, const nc_var_options&);
+
+} // end namespace fminc4
+#endif /* CHUNKING_H */
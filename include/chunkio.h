@@ -0,0 +1,27 @@
+#ifndef CHUNKIO_H
+#define CHUNKIO_H
+
+#include <cstddef>
+#include <vector>
+
+namespace fminc4
+{
+
+struct nc_file;
+
+/*
+ * Whole variable reads and writes that work one storage chunk at a time. Compressed chunks are moved through HDF5
+ * directly under the lock of the file and decompressed or compressed in the shared thread pool, so that decoding
+ * scales with cores while library calls stay serialized. Deflate and shuffle filters are supported.
+ *
+ * Return NC_EINVAL if the variable is not stored that way (contiguous, other filters, foreign byte order, file created
+ * or opened from memory or mapped) and nothing was done, NC_ENOTBUILT without HDF5 support. NC_EINDEFINE if the variable
+ * is not stored yet because the file is in define mode, the caller ends define mode and tries again. Element size is that of the variable type,
+ * caller checks the type and must not hold the lock of the file.
+ */
+
+int ReadChunks(nc_file& theFile, int theNcId, int theVarId, const std::vector<size_t>& theShape, size_t theElementSize, void* theData);
+int WriteChunks(nc_file& theFile, int theNcId, int theVarId, const std::vector<size_t>& theShape, size_t theElementSize, const void* theData);
+
+} // end namespace fminc4
+#endif /* CHUNKIO_H */
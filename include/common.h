@@ -2,6 +2,7 @@
 #define COMMON_H
 
 #include <netcdf.h>
+#include "error.h"
 
 namespace fminc4
 {
@@ -14,10 +15,43 @@ enum NcFileMode
 	kNc4 = NC_NETCDF4
 };
 
+enum NcLockMode
+{
+	kNcLockGlobal, // all library calls serialized through netcdfLibMutex (default)
+	kNcLockFile, // library calls serialized per nc_file, files are accessed concurrently. Requires libnetcdf/HDF5 that tolerate concurrent calls on different ncids
+	kNcLockNone // no locking at all, libnetcdf is built thread-safe
+};
+
+// Intended way of reading a variable, drives automatic chunk shape. Time is expected to be the first dimension.
+enum NcAccessPattern
+{
+	kNcAccessDefault, // library default chunking
+	kNcAccessTimeSlice, // whole horizontal fields, one time step and level at a time
+	kNcAccessTimeSeries // long time series of small areas
+};
+
+// Lossy quantization before compression, values match NC_QUANTIZE_*
+enum NcQuantize
+{
+	kNcQuantizeNone = 0,
+	kNcQuantizeBitGroom = 1,
+	kNcQuantizeGranularBR = 2,
+	kNcQuantizeBitRound = 3
+};
+
+// Access to variables of files opened with CreatePar or OpenPar, values match NC_INDEPENDENT and NC_COLLECTIVE
+enum NcParAccess
+{
+	kNcParIndependent = NC_INDEPENDENT, // each rank reads and writes on its own (library default)
+	kNcParCollective = NC_COLLECTIVE // all ranks take part in every read and write, required for writes to filtered variables and along unlimited dimensions
+};
+
 //predeclarations
 class nc_group;
 class nc_dim;
 class nc_var;
+class nc_metadata;
+struct nc_var_info;
 
 }
 #endif /* COMMON_H */
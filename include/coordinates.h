@@ -0,0 +1,79 @@
+#ifndef COORDINATES_H
+#define COORDINATES_H
+
+#include "common.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fminc4
+{
+
+/*
+ * Values of a coordinate variable (one dimensional variable named after its dimension) with what a search by value
+ * needs. Monotonic coordinates are searched by binary search, evenly spaced ones by computing the index.
+ */
+
+struct nc_coordinate
+{
+	explicit nc_coordinate(std::vector<double>&& theValues);
+
+	// Indexes of values within [theMin, theMax], count 0 if there are none. NC_EINVAL if the values are not monotonic.
+	int Range(double theMin, double theMax, size_t& theStart, size_t& theCount) const;
+
+	// Index of the value closest to theValue. NC_EINVAL if there are no values or they are not monotonic.
+	int Nearest(double theValue, size_t& theIndex) const;
+
+	std::vector<double> itsValues;
+	int itsOrder; // 1 increasing, -1 decreasing, 0 neither
+	bool itsRegular; // evenly spaced by itsStep
+	double itsStep;
+};
+
+// Values of dimensions to read, built up front. Dimensions not in the selection are read whole.
+struct nc_selection
+{
+	nc_selection& Range(const std::string& theDim, double theMin, double theMax); // coordinate values within [min, max]
+	nc_selection& Nearest(const std::string& theDim, double theValue); // one index, coordinate value closest to the value
+	nc_selection& Index(const std::string& theDim, size_t theStart, size_t theCount); // by index, no coordinate needed
+
+	enum kind { kRange, kNearest, kIndex };
+
+	struct item
+	{
+		std::string itsDim;
+		kind itsKind;
+		double itsMin; // value for kNearest
+		double itsMax;
+		size_t itsStart;
+		size_t itsCount;
+	};
+
+	std::vector<item> itsItems;
+};
+
+/*
+ * Coordinates of one file by group and variable, read once and shared by every selection on the file. Entries of
+ * a variable are dropped when it is written to, and all of them by nc_file::Invalidate.
+ */
+
+class nc_coord_cache
+{
+	public:
+	std::shared_ptr<const nc_coordinate> Find(int theNcId, int theVarId) const; // nullptr if not cached
+	void Insert(int theNcId, int theVarId, std::shared_ptr<const nc_coordinate> theCoordinate);
+	void Erase(int theNcId, int theVarId);
+	void Clear();
+
+	private:
+	typedef std::pair<int, int> key; // group id, variable id
+
+	mutable std::mutex itsMutex;
+	std::map<key, std::shared_ptr<const nc_coordinate>> itsCoordinates;
+};
+
+} // end namespace fminc4
+#endif /* COORDINATES_H */
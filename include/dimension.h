@@ -13,19 +13,23 @@ class nc_dim
 {
         public:
 	nc_dim() = default;
-	nc_dim(int, int);
+	nc_dim(std::shared_ptr<nc_file>, int, int); // length is looked up from the metadata of the file
+	nc_dim(std::shared_ptr<nc_file>, int, int, size_t); // known length, 0 for unlimited
 
         std::string Name();
         void Name(const std::string&);
 
         size_t Size();
+	bool Unlimited() const;
 
 	int NcId();
 	int DimId();
 
         private:
+	std::shared_ptr<nc_file> itsFile;
         int itsNcId;
         int itsDimId;
+	size_t itsLength; // fixed length never changes, 0 for unlimited dimensions whose length is queried
 };
 
 }  // end namespace fminc4
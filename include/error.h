@@ -0,0 +1,92 @@
+#ifndef ERROR_H
+#define ERROR_H
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <netcdf.h>
+
+namespace fminc4
+{
+
+// Exception of the throwing API: netcdf status (errno for system errors) and its description from nc_strerror
+class nc_error : public std::runtime_error
+{
+	public:
+	explicit nc_error(int theStatus) : std::runtime_error(nc_strerror(theStatus)), itsStatus(theStatus) {}
+
+	int Status() const { return itsStatus; }
+
+	private:
+	int itsStatus;
+};
+
+// Failed status converting to any nc_result, e.g. return nc_failure(NC_ENOTVAR)
+struct nc_failure
+{
+	explicit nc_failure(int theStatus) : itsStatus(theStatus) {}
+
+	int itsStatus;
+};
+
+/*
+ * Value or netcdf status returned by the non-throwing API (Try* functions). A failure costs no exception,
+ * Value() throws nc_error for a failed result so that the throwing API is a thin wrapper over the Try* call.
+ */
+
+template<typename T>
+class nc_result
+{
+	public:
+	nc_result(const T& theValue) : itsStatus(NC_NOERR), itsValue(theValue) {}
+	nc_result(T&& theValue) : itsStatus(NC_NOERR), itsValue(std::move(theValue)) {}
+	nc_result(nc_failure theFailure) : itsStatus(theFailure.itsStatus), itsValue() {}
+
+	bool Ok() const { return itsStatus == NC_NOERR; }
+	explicit operator bool() const { return Ok(); }
+
+	int Status() const { return itsStatus; }
+	std::string Message() const { return nc_strerror(itsStatus); }
+
+	const T& Value() const & { Check(); return itsValue; }
+	T& Value() & { Check(); return itsValue; }
+	T&& Value() && { Check(); return std::move(itsValue); }
+
+	T ValueOr(const T& theDefault) const { return Ok() ? itsValue : theDefault; }
+
+	private:
+	void Check() const
+	{
+		if(itsStatus != NC_NOERR)
+			throw nc_error(itsStatus);
+	}
+
+	int itsStatus;
+	T itsValue;
+};
+
+template<>
+class nc_result<void>
+{
+	public:
+	nc_result(int theStatus = NC_NOERR) : itsStatus(theStatus) {}
+	nc_result(nc_failure theFailure) : itsStatus(theFailure.itsStatus) {}
+
+	bool Ok() const { return itsStatus == NC_NOERR; }
+	explicit operator bool() const { return Ok(); }
+
+	int Status() const { return itsStatus; }
+	std::string Message() const { return nc_strerror(itsStatus); }
+
+	void Value() const
+	{
+		if(itsStatus != NC_NOERR)
+			throw nc_error(itsStatus);
+	}
+
+	private:
+	int itsStatus;
+};
+
+} // end namespace fminc4
+#endif /* ERROR_H */
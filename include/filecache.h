@@ -0,0 +1,96 @@
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fminc4
+{
+
+struct nc_file;
+
+struct nc_file_cache_stats
+{
+	size_t itsHits; // lookups served by an open (or opening) file
+	size_t itsMisses; // lookups that opened the file
+	size_t itsEvictions; // files closed by the size or idle time limit
+	size_t itsOpenFiles;
+};
+
+/*
+ * Cache of open files by key (path). Keys are spread over independently locked shards so that lookups of
+ * different files do not contend. Concurrent lookups of a file that is being opened wait for that one open.
+ * Files still referenced by handles outside the cache are never evicted.
+ */
+
+class nc_file_cache
+{
+	public:
+	nc_file_cache();
+
+	// File of the key, opened with the given function on a miss. A failed open is not cached, every waiter gets the exception.
+	std::shared_ptr<nc_file> Get(const std::string& theKey, const std::function<std::shared_ptr<nc_file>()>& theOpen);
+
+	// Open file of the key, waits if the file is being opened. nullptr if not in cache.
+	std::shared_ptr<nc_file> Find(const std::string& theKey);
+
+	// Remove file of the key if nothing but the cache and given number of caller held references point to it
+	bool Erase(const std::string& theKey, long theReferences);
+
+	// Drop every file
+	void Clear();
+
+	// Most files kept open and longest time an unreferenced file is kept open, 0 means no limit
+	void Limits(size_t theMaxFiles, std::chrono::seconds theMaxIdle);
+
+	nc_file_cache_stats Stats() const;
+
+	private:
+	typedef std::shared_future<std::shared_ptr<nc_file>> file_future;
+
+	struct entry
+	{
+		file_future itsFile;
+		size_t itsSerial; // identifies the open that created the entry
+		std::chrono::steady_clock::time_point itsLastUse;
+		std::list<std::string>::iterator itsUse;
+	};
+
+	struct shard
+	{
+		std::mutex itsMutex;
+		std::unordered_map<std::string, entry> itsEntries;
+		std::list<std::string> itsUse; // keys, most recently used first
+	};
+
+	static const size_t kShards = 16;
+
+	shard& Shard(const std::string& theKey);
+
+	// Remove unreferenced files idle too long from a shard, caller holds the lock of the shard.
+	// Evicted files are moved to the given vector so that they are closed after the lock is released.
+	void Evict(shard&, std::chrono::steady_clock::time_point theNow, std::vector<file_future>& theEvicted);
+
+	// Remove least recently used unreferenced files of all shards while over the size limit, caller holds no lock
+	void EvictOver(std::vector<file_future>& theEvicted);
+
+	shard itsShards[kShards];
+	std::atomic<size_t> itsMaxFiles;
+	std::atomic<long long> itsMaxIdle; // seconds
+	std::atomic<size_t> itsSerial;
+	std::atomic<size_t> itsHits;
+	std::atomic<size_t> itsMisses;
+	std::atomic<size_t> itsEvictions;
+	std::atomic<size_t> itsOpenFiles;
+};
+
+} // end namespace fminc4
+#endif /* FILECACHE_H */
@@ -1,27 +1,175 @@
 #ifndef FMINC4_H
 #define FMINC4_H
 
+#include <atomic>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <vector>
 #include <netcdf.h>
 #include "common.h"
+#include "filecache.h"
+
+#ifdef FMINC4_HAVE_MPI
+#include <mpi.h>
+#endif
 
 namespace fminc4
 {
 
+extern std::mutex netcdfLibMutex;
+
+class nc_write_queue;
+class nc_metadata;
+class nc_block_cache;
+class nc_mapping;
+class nc_att_cache;
+class nc_catalogue;
+class nc_coord_cache;
+
+// Settings applied when a file is actually opened or created, ignored if the file is already open
+struct nc_open_options
+{
+	nc_open_options() : itsChunkCacheSize(0), itsChunkCacheSlots(0), itsChunkCachePreemption(-1.f), itsBlockCacheSize(0), itsMapped(false), itsAlignment(0), itsInMemory(false), itsParallelChunks(false), itsParAccess(kNcParIndependent) {}
+
+	size_t itsChunkCacheSize; // HDF5 chunk cache bytes per variable, 0 keeps library default
+	size_t itsChunkCacheSlots; // hash slots of the chunk cache, 0 keeps library default
+	float itsChunkCachePreemption; // 0...1, how eagerly fully read chunks are evicted. Negative keeps library default
+	size_t itsBlockCacheSize; // bytes of decoded hyperslab blocks kept in memory to serve small reads, 0 disables
+	bool itsMapped; // Open only: map the file read-only into memory, the file cannot be modified through the returned group
+	size_t itsAlignment; // Create only: start data of variables of at least this many bytes at multiples of it (e.g. page size) so that views of mapped files can be used in place. 0 keeps library default
+	bool itsInMemory; // Create only: file is kept in memory and path is only a key in the file cache. Bytes are handed back by Close(path, bytes)
+	bool itsParallelChunks; // whole variable Read and Write of chunked, deflate/shuffle filtered variables decode and encode chunks in the shared thread pool. Needs HDF5 support (make HDF5=1), ignored otherwise
+	NcParAccess itsParAccess; // CreatePar and OpenPar only: access to every variable of the file, changed per variable with nc_var::ParAccess
+};
+
+// Lock for calls that touch library wide state (open, create, close, HDF5 files opened behind the library).
+// Empty in kNcLockNone mode.
+std::unique_lock<std::mutex> LibraryLock(NcLockMode);
+
+// Locking model for files opened or created after the call
+void LockMode(NcLockMode);
+NcLockMode LockMode();
+
 struct nc_file
 {
-        nc_file(int theNcId) : itsNcId(theNcId) {};
-        ~nc_file()
-        {
-                nc_close(itsNcId);
-        }
+        nc_file(int theNcId, NcLockMode theLockMode = LockMode(), const nc_open_options& theOptions = nc_open_options(), std::shared_ptr<nc_mapping> theMapping = nullptr, const std::string& thePath = std::string(), bool theParallel = false);
+        ~nc_file();
+
+	// Lock protecting library calls on this file, as selected by the lock mode when the file was opened.
+	// Returned lock is empty (owns no mutex) in kNcLockNone mode.
+	std::unique_lock<std::mutex> Lock();
+
+	// Queue for asynchronous writes, background thread is started on first use
+	nc_write_queue& WriteQueue();
+
+	// Wait until all queued asynchronous writes have been written
+	void Flush();
+
+	// Snapshot of file structure, scanned again on first use after Invalidate(). Must not be called while holding Lock().
+	std::shared_ptr<const nc_metadata> Metadata();
+	nc_result<std::shared_ptr<const nc_metadata>> TryMetadata(); // failed scan as netcdf status, nothing is thrown
+
+	// Name, type and dimensions of a variable as given, kept as long as the file is so that handles can point to them
+	// without owning anything. First description of the variable wins, its attributes are not kept.
+	const nc_var_info* Layout(int theNcId, int theVarId, const nc_var_info&);
+
+	// Discard the snapshot, decoded attributes, coordinates and cached blocks after a define mode operation changed the file
+	void Invalidate();
+
+	// Apply chunk cache settings of the options to a variable. Caller must hold the lock.
+	int ConfigureChunkCache(int theNcId, int theVarId);
+
+	// Apply parallel access of the options to a variable of a parallel file, nothing for other files. Caller must hold the lock.
+	int ConfigureParAccess(int theNcId, int theVarId);
+
+	// Cache of decoded blocks, nullptr if disabled
+	nc_block_cache* BlockCache();
+
+	// Decoded attribute values, see attributes.h
+	nc_att_cache& AttCache();
+
+	// Values of coordinate variables read for selections by value, see coordinates.h
+	nc_coord_cache& CoordCache();
+
+	// Independent read-only handle to the same file with the options of this one, not registered in the file cache. Throws
+	// NC_EINMEMORY for files created in memory and NC_EINVAL for parallel files.
+	std::shared_ptr<nc_file> Reopen();
+
+	// Read-only handle for a reader on another thread, an idle one of earlier readers if no write went through this handle
+	// since it was opened, otherwise from Reopen. Given back with Release to be reused, throws like Reopen.
+	std::shared_ptr<nc_file> Sibling();
+	void Release(std::shared_ptr<nc_file>);
+
+	// Data written through this handle, idle siblings are not reused afterwards. Invalidate counts as a write.
+	void Modified();
+
+	// Close a file created in memory and return its contents. The handle must not be used afterwards.
+	std::vector<unsigned char> CloseInMemory();
 
         const int itsNcId;
+	const NcLockMode itsLockMode;
+	const nc_open_options itsOptions;
+	const std::shared_ptr<nc_mapping> itsMapping; // memory the file was opened from, nullptr unless opened mapped. Outlives the library handle.
+	const std::string itsPath; // path or key the file was opened with
+	const bool itsParallel; // opened with CreatePar or OpenPar, every rank of the communicator holds the file open
+
+	private:
+	std::unique_lock<std::mutex> Acquire();
+
+	std::mutex itsMutex;
+	std::mutex itsWriteQueueMutex;
+	std::unique_ptr<nc_write_queue> itsWriteQueue;
+	std::shared_ptr<const nc_metadata> itsMetadata; // accessed atomically
+	std::mutex itsLayoutMutex;
+	std::map<std::pair<int, int>, std::unique_ptr<const nc_var_info>> itsLayouts; // by group id and variable id
+	std::unique_ptr<nc_block_cache> itsBlockCache;
+	std::unique_ptr<nc_att_cache> itsAttCache;
+	std::unique_ptr<nc_coord_cache> itsCoordCache;
+	std::atomic<size_t> itsWrites; // calls to Modified
+	size_t itsSiblingWrites; // of the original handle when this sibling was opened
+	std::mutex itsSiblingMutex;
+	std::vector<std::shared_ptr<nc_file>> itsSiblings; // idle, opened after the same number of writes
+	bool itsClosed;
 };
 
-nc_group Create(const std::string&);
-nc_group Open(const std::string&);
+nc_group Create(const std::string&, const nc_open_options& = nc_open_options());
+nc_group Open(const std::string&, const nc_open_options& = nc_open_options());
+
+// Read-only file not registered in the file cache, closed with the last handle. For one-off scans of many files.
+nc_group OpenUncached(const std::string&);
+
+#ifdef FMINC4_HAVE_MPI
+/*
+ * Parallel I/O through MPI-IO (make MPI=1, libnetcdf built with parallel HDF5). Every rank of the communicator calls
+ * these, and all define mode calls (AddDim, AddVar, AddAtt, Define...) and Close in the same order. Reads and writes
+ * are independent unless the access is collective, see NcParAccess. The block cache, parallel chunk engine, mapping
+ * and in memory options do not apply to parallel files.
+ */
+
+nc_group CreatePar(const std::string&, MPI_Comm, MPI_Info = MPI_INFO_NULL, const nc_open_options& = nc_open_options());
+nc_group OpenPar(const std::string&, MPI_Comm, MPI_Info = MPI_INFO_NULL, const nc_open_options& = nc_open_options());
+#endif
+
+// Open file contents held in memory read-only, registered in the file cache under the given key. Takes over the buffer.
+nc_group Open(const std::string&, std::vector<unsigned char>&&, const nc_open_options& = nc_open_options());
+
 bool Close(const std::string&);
+
+// Catalogue of a whole file, read from its sidecar (path + kNcCatalogueSuffix) when the sidecar matches the size and
+// modification time of the file. Otherwise the file is walked and the sidecar written, through the cached handle if the
+// file is open and read-only with OpenUncached if not. A sidecar that cannot be written (read only archive) is not an
+// error. A file that cannot be found throws NC_ENOTFOUND, one that may not be accessed NC_EPERM.
+nc_catalogue Catalogue(const std::string&);
+
+// Close a file created in memory and hand back its contents. Fails like Close if the file is still in use.
+bool Close(const std::string&, std::vector<unsigned char>&);
+// Limits of the file cache: most files kept open and longest idle time in seconds of files no handle refers to, 0 means no limit.
+// Files in use stay open regardless.
+void FileCacheLimits(size_t theMaxFiles, size_t theMaxIdleSeconds);
+nc_file_cache_stats FileCacheStats();
+
 void Finalize();
 
 } // end namespace fminc4
@@ -6,6 +6,11 @@
 #include <vector>
 #include <memory>
 #include "fminc4.h"
+#include "chunking.h"
+#include "schema.h"
+#include "catalogue.h"
+#include "traits.h"
+#include "stats.h"
 
 namespace fminc4
 {
@@ -18,37 +23,84 @@ class nc_group
 
 	// sub groups
 	nc_group GetGroup(const std::string&);
+	nc_result<nc_group> TryGetGroup(const std::string&); // NC_ENOGRP if not found, nothing is thrown
 	nc_group AddGroup(const std::string&);
-	std::vector<std::string> ListGroups() const;
+	std::vector<std::string> ListGroups() const; // names in definition order
 	//---
 
         // dimensions
         nc_dim GetDim(const std::string&);
+	nc_result<nc_dim> TryGetDim(const std::string&); // NC_EBADDIM if not found, nothing is thrown
         nc_dim AddDim(const std::string&, size_t);
 	std::vector<nc_dim> ListDims() const;
 	//---
 
 	// variables
         nc_var GetVar(const std::string&);
-	nc_var AddVar(const std::string&, const std::vector<nc_dim>&, const nc_type&);
+	nc_result<nc_var> TryGetVar(const std::string&); // NC_ENOTVAR if not found, nothing is thrown
+	nc_var AddVar(const std::string&, const std::vector<nc_dim>&, const nc_type&, const nc_var_options& = nc_var_options()); // options set chunking and compression
 
 	std::vector<nc_var> ListVars() const;
+
+	// Read entire variables in parallel, results in order of names. Every worker reads through its own handle to the file,
+	// files created in memory and parallel files through this handle.
+	// Number of workers defaults to thread pool size, workers scale with cores only when lock mode is not kNcLockGlobal.
+	// Called from a task of the thread pool, variables are read one after another in the calling thread.
+	template<typename T>
+	void ReadMany(const std::vector<std::string>&, std::vector<std::vector<T>>&, size_t = 0);
 	//---
 
 	// attributes
+	// values converted to ATT_TYPE from the type of the attribute, decoded attributes are cached in the file.
+	// ATT_TYPE is one of the element types or std::string (text or string attributes).
 	template<typename ATT_TYPE>
 	std::vector<ATT_TYPE> GetAtt(const std::string&);
 
+	template<typename ATT_TYPE>
+	nc_result<std::vector<ATT_TYPE>> TryGetAtt(const std::string&); // NC_ENOTATT if not found, nothing is thrown
+
 	template<typename ATT_TYPE>
 	void AddAtt(const std::string&, const std::vector<ATT_TYPE>&);
 
+	template<typename ATT_TYPE>
+	void AddAtt(const std::string&, const ATT_TYPE&);
+
+	void AddTextAtt(const std::string&, const std::string&);
+
+	void AddAtt(const std::string&, const std::vector<std::string>&); // NC_STRING attribute
+
 	std::vector<std::tuple<std::string, nc_type, size_t>> ListAtts() const;
 	//---
 
+	// schema
+	void Define(const nc_schema&); // everything in the schema in one define mode pass, holding the lock once
+	nc_schema Schema() const; // dimensions, variables with storage options and attributes of this group
+	//---
+
+	// catalogue
+	nc_catalogue Walk() const; // this group and all sub groups with dimensions, variables and attribute values, see catalogue.h
+	//---
+
         private:
+	void PutAtt(const std::string&, nc_type, size_t theLength, size_t theSize, const void*); // Out of line so that instrumentation does not depend on how clients are built
+
         std::shared_ptr<nc_file> itsFile;
 	int itsGroupId;
 };
 
+//Implementation in header as otherwise all permutations of ATT_TYPE needed to be explicitly instantiated
+template <typename ATT_TYPE>
+void nc_group::AddAtt(const std::string& name, const std::vector<ATT_TYPE>& values)
+{
+	// attribute gets the natural type of ATT_TYPE, see nc_traits
+	PutAtt(name, nc_traits<ATT_TYPE>::value, values.size(), sizeof(ATT_TYPE), values.data());
+}
+
+template <typename ATT_TYPE>
+void nc_group::AddAtt(const std::string& name, const ATT_TYPE& value)
+{
+	AddAtt(name, std::vector<ATT_TYPE>(1, value));
+}
+
 } // end namespace fminc4
 #endif /* GROUP_H */
@@ -0,0 +1,28 @@
+#ifndef HYPERSLAB_H
+#define HYPERSLAB_H
+
+#include <cstddef>
+#include <vector>
+
+namespace fminc4
+{
+
+// Number of elements in a hyperslab
+size_t Volume(const std::vector<size_t>& theCount);
+
+// Intersection of two hyperslabs, false if they do not overlap
+bool Intersect(const std::vector<size_t>& theStartA, const std::vector<size_t>& theCountA,
+		const std::vector<size_t>& theStartB, const std::vector<size_t>& theCountB,
+		std::vector<size_t>& theStart, std::vector<size_t>& theCount);
+
+/*
+ * Copy region theStart/theCount (in variable index space) from a row-major source hyperslab to a row-major destination hyperslab.
+ * Region must lie inside both. Elements are copied as raw bytes of given size.
+ */
+
+void CopyHyperslab(const void* theSrc, const std::vector<size_t>& theSrcStart, const std::vector<size_t>& theSrcCount,
+		void* theDst, const std::vector<size_t>& theDstStart, const std::vector<size_t>& theDstCount,
+		const std::vector<size_t>& theStart, const std::vector<size_t>& theCount, size_t theElementSize);
+
+} // end namespace fminc4
+#endif /* HYPERSLAB_H */
@@ -0,0 +1,83 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "common.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fminc4
+{
+
+struct nc_index_dim
+{
+	std::string itsName;
+	size_t itsLength;
+	double itsMin; // range of the coordinate variable of the dimension, NaN if there is none
+	double itsMax;
+};
+
+// Variable of an indexed file
+struct nc_index_entry
+{
+	std::string itsFile;
+	std::string itsGroup; // full path of the group
+	std::string itsName;
+	nc_type itsType;
+	std::vector<nc_index_dim> itsDims;
+	double itsTimeFrom; // valid times in seconds since 1970-01-01 UTC from a time coordinate ("hours since ..."), NaN if none
+	double itsTimeTo;
+	std::vector<std::pair<std::string, std::string>> itsAtts; // key attributes with text values
+};
+
+// Outcome of nc_index::Update
+struct nc_index_update
+{
+	size_t itsKept; // unchanged files taken from the index
+	size_t itsScanned;
+	std::vector<std::pair<std::string, int>> itsFailed; // files left out of the index with netcdf status or errno
+};
+
+class nc_index_table;
+
+/*
+ * Index of the variables of many files kept in one file, answering which files hold a variable (for some valid
+ * time) without opening any of them. The index file is mapped into memory and searched in place, nothing is
+ * decoded when it is opened. Update scans only files whose size or modification time changed and writes a new
+ * index file, queries running meanwhile see the old or the new index.
+ */
+
+class nc_index
+{
+	public:
+	// Index file is read if it exists. Missing, unreadable or foreign index files are an empty index, rebuilt by Update.
+	// Key attributes are the text attributes of variables kept in the index.
+	explicit nc_index(const std::string& thePath, const std::vector<std::string>& theKeyAtts = {"standard_name", "long_name", "units"});
+
+	// Index exactly these files: unchanged files are kept, changed and new ones scanned, files not listed are dropped.
+	// Files are opened read-only without the file cache. Throws nc_error carrying errno if the index cannot be written.
+	nc_index_update Update(const std::vector<std::string>& theFiles);
+
+	// Files holding the variable, in the order given to Update
+	std::vector<std::string> Files(const std::string& theVar) const;
+
+	// Files where valid times of the variable overlap [theFrom, theTo], seconds since 1970-01-01 UTC
+	std::vector<std::string> Files(const std::string& theVar, double theFrom, double theTo) const;
+
+	// Files where coordinates of the dimension of the variable overlap [theMin, theMax], in units of the files
+	std::vector<std::string> Files(const std::string& theVar, const std::string& theDim, double theMin, double theMax) const;
+
+	std::vector<nc_index_entry> Entries(const std::string& theVar) const;
+	size_t Size() const; // files
+
+	private:
+	const std::string itsPath;
+	const std::vector<std::string> itsKeyAtts;
+	std::shared_ptr<const nc_index_table> itsTable; // accessed atomically
+	std::mutex itsUpdateMutex;
+};
+
+} // end namespace fminc4
+#endif /* INDEX_H */
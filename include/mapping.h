@@ -0,0 +1,54 @@
+#ifndef MAPPING_H
+#define MAPPING_H
+
+#include "common.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fminc4
+{
+
+/*
+ * Read-only memory holding a whole file. The library reads the file from memory.
+ * Either a mapping, whose pages are shared with other processes mapping or reading the same file through the page cache,
+ * or a buffer handed over by the caller.
+ */
+
+class nc_mapping
+{
+	public:
+	explicit nc_mapping(const std::string& thePath); // throws nc_error NC_ENOTNC if the file cannot be mapped, NC_EPERM or NC_ENOMEM
+	explicit nc_mapping(std::vector<unsigned char>&& theBuffer);
+	~nc_mapping();
+
+	nc_mapping(const nc_mapping&) = delete;
+	nc_mapping& operator=(const nc_mapping&) = delete;
+
+	const void* Data() const;
+	size_t Size() const;
+
+	// Byte offset of the data of a contiguous, unfiltered netcdf-4 variable given by its full path (/group/variable).
+	// Looked up once per variable. Returns NC_EINVAL if data of the variable is not stored that way or not written yet
+	// or if the memory is not a mapped file, NC_ENOTBUILT without HDF5 support. The file is opened again through HDF5
+	// holding the library lock of the given mode, caller must not hold it.
+	int Offset(const std::string& theVarPath, NcLockMode theLockMode, size_t& theOffset);
+
+	private:
+	const std::string itsPath; // empty for buffers
+	void* itsData;
+	size_t itsSize;
+	std::vector<unsigned char> itsBuffer;
+
+	std::mutex itsMutex;
+	std::map<std::string, std::pair<int, size_t>> itsOffsets; // lookup status and offset by variable path
+};
+
+// Write a whole file through a temporary file renamed over it, so that readers and mappings see the old or the new
+// contents, never a partial file. Throws nc_error carrying errno.
+void ReplaceFile(const std::string& thePath, const std::string& theData);
+
+} // end namespace fminc4
+#endif /* MAPPING_H */
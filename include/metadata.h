@@ -0,0 +1,80 @@
+#ifndef METADATA_H
+#define METADATA_H
+
+#include "common.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fminc4
+{
+
+struct nc_att_info
+{
+	std::string itsName;
+	nc_type itsType;
+	size_t itsLength;
+};
+
+struct nc_dim_info
+{
+	std::string itsName;
+	size_t itsLength; // length at scan time, unlimited dimensions grow and must be queried from the library
+	bool itsUnlimited;
+};
+
+struct nc_var_info
+{
+	std::string itsName;
+	nc_type itsType;
+	std::vector<int> itsDimIds;
+	std::vector<size_t> itsLengths; // of dimensions, 0 for unlimited dimensions whose length must be queried
+	std::vector<nc_att_info> itsAtts;
+};
+
+struct nc_group_info
+{
+	std::string itsName; // "/" for root group
+	int itsParentId; // -1 for root group
+	std::vector<int> itsGroupIds; // sub groups, in definition order
+	std::vector<int> itsDimIds; // dimensions defined in this group, in definition order
+	std::vector<nc_var_info> itsVars; // indexed by variable id
+	std::vector<nc_att_info> itsAtts; // group attributes
+	std::unordered_map<std::string, int> itsDimNames;
+	std::unordered_map<std::string, int> itsVarNames;
+	std::unordered_map<std::string, int> itsGroupNames;
+};
+
+/*
+ * Immutable snapshot of the structure of an open file: groups, dimensions, variables and attribute names.
+ * Held by nc_file and replaced as a whole when define mode operations change the file.
+ */
+
+class nc_metadata
+{
+	public:
+	// Scan whole file starting from root group, caller must hold the lock of the file
+	static std::shared_ptr<const nc_metadata> Scan(int theNcId);
+
+	const nc_group_info* Group(int theGroupId) const; // nullptr if not found
+	const std::unordered_map<int, nc_group_info>& Groups() const;
+	const nc_dim_info* Dim(int theDimId) const;
+	const nc_var_info* Var(int theGroupId, int theVarId) const;
+
+	// Name lookups return -1 if not found. Dimensions are searched from parent groups too, like nc_inq_dimid does.
+	int DimId(int theGroupId, const std::string&) const;
+	int VarId(int theGroupId, const std::string&) const;
+	int GroupId(int theGroupId, const std::string&) const; // sub group of the group
+
+	std::string Path(int theGroupId) const; // "/" for root group, "/a/b" for sub groups, empty if not found
+
+	private:
+	void ScanGroup(int theGroupId, int theParentId);
+
+	std::unordered_map<int, nc_group_info> itsGroups;
+	std::unordered_map<int, nc_dim_info> itsDims; // dimension ids are unique within a file
+};
+
+} // end namespace fminc4
+#endif /* METADATA_H */
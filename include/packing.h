@@ -0,0 +1,90 @@
+#ifndef PACKING_H
+#define PACKING_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <netcdf.h>
+
+namespace fminc4
+{
+
+// CF packing of a variable: unpacked = packed * scale_factor + add_offset. Fill value is in packed units.
+struct nc_packing
+{
+	nc_packing() : itsScale(1), itsOffset(0), itsHasFill(false), itsFill(0) {}
+
+	double itsScale;
+	double itsOffset;
+	bool itsHasFill; // _FillValue, or missing_value if there is no _FillValue
+	double itsFill;
+};
+
+/*
+ * Reference unpacking, also used for packed types without a vectorized kernel. Values equal to fill become NaN.
+ * Arithmetic is done in the unpacked type T so that vectorized kernels give identical results.
+ */
+
+template<typename P, typename T>
+void UnpackScalar(const P* theSrc, size_t theSize, T* theDst, const nc_packing& thePacking)
+{
+	const T scale = static_cast<T>(thePacking.itsScale);
+	const T offset = static_cast<T>(thePacking.itsOffset);
+	const P fill = static_cast<P>(thePacking.itsFill);
+
+	for(size_t i = 0; i < theSize; ++i)
+	{
+		const T value = static_cast<T>(theSrc[i]) * scale + offset;
+		theDst[i] = thePacking.itsHasFill && theSrc[i] == fill ? std::numeric_limits<T>::quiet_NaN() : value;
+	}
+}
+
+// Unpack short data with the best kernel the cpu supports (AVX-512, AVX2 or scalar)
+void Unpack(const short*, size_t, float*, const nc_packing&);
+void Unpack(const short*, size_t, double*, const nc_packing&);
+
+// Other packed types use the scalar kernel
+template<typename P, typename T>
+void Unpack(const P* theSrc, size_t theSize, T* theDst, const nc_packing& thePacking)
+{
+	UnpackScalar(theSrc, theSize, theDst, thePacking);
+}
+
+// Name of the kernel Unpack selected on this cpu
+const char* UnpackKernel();
+
+/*
+ * Quantize to packed type: round((value - add_offset) / scale_factor). NaN becomes the fill value.
+ * Returns NC_ERANGE if a value does not fit the packed type or is NaN without a fill value.
+ */
+
+template<typename T, typename P>
+int Pack(const T* theSrc, size_t theSize, P* theDst, const nc_packing& thePacking)
+{
+	const double lowest = static_cast<double>(std::numeric_limits<P>::lowest());
+	const double highest = static_cast<double>(std::numeric_limits<P>::max());
+
+	for(size_t i = 0; i < theSize; ++i)
+	{
+		if(std::isnan(theSrc[i]))
+		{
+			if(!thePacking.itsHasFill)
+				return NC_ERANGE;
+
+			theDst[i] = static_cast<P>(thePacking.itsFill);
+			continue;
+		}
+
+		const double value = std::round((static_cast<double>(theSrc[i]) - thePacking.itsOffset) / thePacking.itsScale);
+		if(value < lowest || value > highest)
+			return NC_ERANGE;
+
+		theDst[i] = static_cast<P>(value);
+	}
+
+	return NC_NOERR;
+}
+
+} // end namespace fminc4
+#endif /* PACKING_H */
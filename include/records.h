@@ -0,0 +1,73 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+
+#include "variable.h"
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace fminc4
+{
+
+/*
+ * Walks the records of a variable along its first (unlimited) dimension, a block of records at a time.
+ * The next block is read in the thread pool while the current one is processed, so at most two blocks are held in memory.
+ * Used from a task of the pool the next block is read right away instead, as tasks must not wait for other tasks.
+ * Records appended meanwhile are picked up, Next() can be called again after it returned false.
+ */
+
+template<typename T>
+class nc_record_reader
+{
+	public:
+	nc_record_reader(const nc_var&, size_t theBlock, size_t theStart);
+	~nc_record_reader(); // waits for a pending read
+
+	nc_record_reader(nc_record_reader&&) = default;
+	nc_record_reader(const nc_record_reader&) = delete;
+	nc_record_reader& operator=(const nc_record_reader&) = delete;
+
+	// Advance to next block, false if there are no more records
+	bool Next();
+
+	const std::vector<T>& Data() const { return itsData; } // values of current block, records after each other
+	size_t Record() const { return itsRecord; } // index of first record of current block
+	size_t Count() const { return itsCount; } // records in current block, less than block size at the end
+
+	private:
+	void Prefetch(size_t theRecord);
+
+	nc_var itsVar;
+	size_t itsBlock;
+	size_t itsRecord;
+	size_t itsCount;
+	std::vector<T> itsData;
+
+	// block being read in the background
+	std::shared_ptr<std::vector<T>> itsNext;
+	size_t itsNextRecord;
+	size_t itsNextCount;
+	std::future<void> itsPending;
+};
+
+// Appends whole records after the last record of a variable along its first (unlimited) dimension
+template<typename T>
+class nc_record_appender
+{
+	public:
+	explicit nc_record_appender(const nc_var&);
+
+	void Append(const T*, size_t); // length must be a multiple of the record length
+	void Append(const std::vector<T>&);
+
+	size_t Records() const { return itsNext; } // records in the variable, index of the next record
+
+	private:
+	nc_var itsVar;
+	std::vector<size_t> itsCount; // one record
+	size_t itsRecordLength;
+	size_t itsNext;
+};
+
+} // end namespace fminc4
+#endif /* RECORDS_H */
@@ -0,0 +1,93 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include "common.h"
+#include "chunking.h"
+#include "traits.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace fminc4
+{
+
+struct nc_att_schema
+{
+	std::string itsName;
+	nc_type itsType;
+	size_t itsLength;
+	std::vector<unsigned char> itsValues; // raw values of the type, characters for NC_CHAR
+	std::vector<std::string> itsStrings; // values of NC_STRING attributes
+};
+
+struct nc_dim_schema
+{
+	std::string itsName;
+	size_t itsLength; // 0 is unlimited
+	std::string itsGroup; // path of the parent group defining the dimension, empty for dimensions of the group itself
+};
+
+struct nc_var_schema
+{
+	std::string itsName;
+	nc_type itsType;
+	std::vector<std::string> itsDims; // names of dimensions in the schema or already in the group
+	nc_var_options itsOptions;
+	std::vector<nc_att_schema> itsAtts;
+};
+
+/*
+ * Description of dimensions, variables with their storage options, and attributes of a group, built up front and
+ * defined in one pass with nc_group::Define. nc_group::Schema describes an existing group, to be copied to a new file,
+ * with chunking, deflate, shuffle, zstd and quantization. Zstd and quantization are only seen if libnetcdf was built with
+ * them, filters other than these are not copied.
+ * Attribute functions take the name of the variable, empty for group attributes. The variable must be added first.
+ * Dimensions that variables of the group use from parent groups are described with the path of their group. Define
+ * uses the dimension of that name if the group is the defined group or one of its parents and already has one, and
+ * defines it there otherwise, or in the defined group when no parent has that path.
+ */
+
+struct nc_schema
+{
+	nc_schema& AddDim(const std::string&, size_t);
+	nc_schema& AddVar(const std::string&, const std::vector<std::string>&, nc_type, const nc_var_options& = nc_var_options());
+
+	template<typename T>
+	nc_schema& AddAtt(const std::string& theVar, const std::string& theName, const std::vector<T>& theValues);
+
+	template<typename T>
+	nc_schema& AddAtt(const std::string& theVar, const std::string& theName, const T& theValue);
+
+	nc_schema& AddTextAtt(const std::string& theVar, const std::string& theName, const std::string& theValue);
+
+	std::vector<nc_att_schema>& Atts(const std::string& theVar); // throws NC_ENOTVAR if the variable is not in the schema
+
+	std::vector<nc_dim_schema> itsDims;
+	std::vector<nc_var_schema> itsVars;
+	std::vector<nc_att_schema> itsAtts; // group attributes
+};
+
+template<typename T>
+nc_schema& nc_schema::AddAtt(const std::string& theVar, const std::string& theName, const std::vector<T>& theValues)
+{
+	nc_att_schema att;
+	att.itsName = theName;
+	att.itsType = nc_traits<T>::value;
+	att.itsLength = theValues.size();
+	att.itsValues.resize(theValues.size() * sizeof(T));
+
+	if(!theValues.empty())
+		std::memcpy(att.itsValues.data(), theValues.data(), att.itsValues.size());
+
+	Atts(theVar).push_back(att);
+	return *this;
+}
+
+template<typename T>
+nc_schema& nc_schema::AddAtt(const std::string& theVar, const std::string& theName, const T& theValue)
+{
+	return AddAtt(theVar, theName, std::vector<T>(1, theValue));
+}
+
+} // end namespace fminc4
+#endif /* SCHEMA_H */
@@ -0,0 +1,132 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace fminc4
+{
+
+class nc_var;
+
+// Kinds of calls counted by the instrumentation
+enum NcStatsOp
+{
+	kNcStatsOpen,
+	kNcStatsCreate,
+	kNcStatsRead,
+	kNcStatsWrite,
+	kNcStatsAttribute, // GetAtt, AddAtt
+	kNcStatsMetadata, // scans of file structure and define mode calls
+	kNcStatsOps
+};
+
+// Latency histogram: bucket i counts calls shorter than 2^i microseconds, last bucket the rest
+const size_t kNcLatencyBuckets = 24;
+
+struct nc_op_stats
+{
+	nc_op_stats() : itsCalls(0), itsErrors(0), itsBytes(0), itsSeconds(0), itsLockWaitSeconds(0), itsLatency() {}
+
+	void Add(const nc_op_stats&);
+
+	size_t itsCalls;
+	size_t itsErrors; // calls that threw or returned an error status
+	size_t itsBytes; // bytes of data read or written by the caller
+	double itsSeconds;
+	double itsLockWaitSeconds; // part of itsSeconds spent waiting for the lock of the file or the library
+	size_t itsLatency[kNcLatencyBuckets];
+};
+
+// Counters of one file, or of one variable of it
+struct nc_io_stats
+{
+	std::string itsFile; // path or key the file was opened with
+	std::string itsVar; // empty for calls on the file or its groups
+	nc_op_stats itsOps[kNcStatsOps];
+};
+
+/*
+ * Instrumentation of public entry points: call counts, bytes, latency and lock wait per file and variable.
+ * Compiled in with FMINC4_STATS (make STATS=1) and off until switched on, without FMINC4_STATS nothing is
+ * recorded and entry points carry no instrumentation at all. Counters are kept per thread and merged on snapshot.
+ * Only the outermost entry point of a thread is measured, calls it makes on its own are part of it.
+ */
+
+void Instrument(bool);
+bool Instrument();
+
+std::vector<nc_io_stats> IoStats(); // snapshot, ordered by file and variable
+void ResetIoStats();
+
+std::string IoStatsJson();
+std::string IoStatsPrometheus(); // Prometheus text exposition format
+
+// Measures the entry point it is created in, see FMINC4_STATS_SCOPE
+class nc_stats_scope
+{
+	public:
+	nc_stats_scope(NcStatsOp theOp, const std::string& theFile, const nc_var* theVar = nullptr);
+	~nc_stats_scope();
+
+	nc_stats_scope(const nc_stats_scope&) = delete;
+	nc_stats_scope& operator=(const nc_stats_scope&) = delete;
+
+	bool Active() const { return itsActive; }
+	void Bytes(size_t theBytes) { itsBytes += theBytes; }
+	void Failed() { itsFailed = true; } // call returned an error status instead of throwing
+
+	// Time spent waiting for a lock, charged to the call measured on this thread if any
+	static bool Measuring();
+	static void LockWait(std::chrono::steady_clock::duration);
+
+	private:
+	bool itsActive;
+	NcStatsOp itsOp;
+	const std::string& itsFile;
+	const nc_var* itsVar;
+	size_t itsBytes;
+	bool itsFailed;
+	int itsExceptions; // in flight when the call started, so that unwinding through it can be told apart
+	std::chrono::steady_clock::time_point itsStart;
+	std::chrono::steady_clock::duration itsLockWait;
+};
+
+// Charges the time from its creation to its destruction to the measured call as lock wait
+class nc_lock_timer
+{
+	public:
+	nc_lock_timer() : itsActive(nc_stats_scope::Measuring())
+	{
+		if(itsActive)
+			itsStart = std::chrono::steady_clock::now();
+	}
+
+	~nc_lock_timer()
+	{
+		if(itsActive)
+			nc_stats_scope::LockWait(std::chrono::steady_clock::now() - itsStart);
+	}
+
+	private:
+	bool itsActive;
+	std::chrono::steady_clock::time_point itsStart;
+};
+
+} // end namespace fminc4
+
+#ifdef FMINC4_STATS
+#define FMINC4_STATS_SCOPE(OP, FILE, VAR) fminc4::nc_stats_scope statsScope(OP, FILE, VAR)
+#define FMINC4_STATS_BYTES(BYTES) do { if(statsScope.Active()) statsScope.Bytes(BYTES); } while(0)
+#define FMINC4_STATS_LOCK_WAIT() fminc4::nc_lock_timer lockTimer
+#define FMINC4_STATS_ERROR(STATUS) do { if(statsScope.Active() && (STATUS) != 0) statsScope.Failed(); } while(0)
+#else
+#define FMINC4_STATS_SCOPE(OP, FILE, VAR) ((void)0)
+#define FMINC4_STATS_BYTES(BYTES) ((void)sizeof(BYTES)) // not evaluated, only keeps what it names in use
+#define FMINC4_STATS_LOCK_WAIT() ((void)0)
+#define FMINC4_STATS_ERROR(STATUS) ((void)0)
+#endif
+
+#endif /* STATS_H */
@@ -0,0 +1,50 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fminc4
+{
+
+// Fixed size pool of worker threads running submitted tasks in submission order
+class nc_thread_pool
+{
+	public:
+	explicit nc_thread_pool(size_t theThreads);
+	~nc_thread_pool(); // finishes queued tasks before returning
+
+	nc_thread_pool(const nc_thread_pool&) = delete;
+	nc_thread_pool& operator=(const nc_thread_pool&) = delete;
+
+	// Future carries the exception thrown by the task, if any
+	std::future<void> Submit(std::function<void()>);
+
+	size_t Size() const;
+
+	// true on worker threads of any pool, where tasks must run inline instead of waiting for new tasks
+	static bool InWorker();
+
+	private:
+	void Run();
+
+	std::mutex itsMutex;
+	std::condition_variable itsWork;
+	std::deque<std::function<void()>> itsTasks;
+	bool itsStop;
+	std::vector<std::thread> itsThreads;
+};
+
+// Pool shared by the batch operations of the library, hardware concurrency threads unless set otherwise.
+// Tasks running in the pool must not wait for other tasks of the pool.
+std::shared_ptr<nc_thread_pool> ThreadPool();
+void ThreadPoolSize(size_t);
+
+} // end namespace fminc4
+#endif /* THREADPOOL_H */
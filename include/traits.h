@@ -0,0 +1,110 @@
+#ifndef TRAITS_H
+#define TRAITS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <netcdf.h>
+
+namespace fminc4
+{
+
+// Element types Read, Write and the other typed functions are instantiated for
+#define FMINC4_ELEMENT_TYPES(X) \
+	X(int8_t) X(uint8_t) X(short) X(unsigned short) X(int) X(unsigned int) X(int64_t) X(uint64_t) X(float) X(double)
+
+/*
+ * Typed library functions of one external type, with the C type they use.
+ * Library converts between the memory type and the type of the variable on read and write.
+ */
+
+template<nc_type> struct nc_typed_api;
+
+#define FMINC4_TYPED_API(NCTYPE, CTYPE, SUFFIX) \
+template<> struct nc_typed_api<NCTYPE> \
+{ \
+	typedef CTYPE type; \
+	static int GetVar(int n, int v, type* d) { return nc_get_var_##SUFFIX(n, v, d); } \
+	static int GetVar1(int n, int v, const size_t* i, type* d) { return nc_get_var1_##SUFFIX(n, v, i, d); } \
+	static int GetVara(int n, int v, const size_t* s, const size_t* c, type* d) { return nc_get_vara_##SUFFIX(n, v, s, c, d); } \
+	static int GetVars(int n, int v, const size_t* s, const size_t* c, const ptrdiff_t* st, type* d) { return nc_get_vars_##SUFFIX(n, v, s, c, st, d); } \
+	static int PutVar(int n, int v, const type* d) { return nc_put_var_##SUFFIX(n, v, d); } \
+	static int PutVar1(int n, int v, const size_t* i, const type* d) { return nc_put_var1_##SUFFIX(n, v, i, d); } \
+	static int PutVara(int n, int v, const size_t* s, const size_t* c, const type* d) { return nc_put_vara_##SUFFIX(n, v, s, c, d); } \
+	static int GetAtt(int n, int v, const char* a, type* d) { return nc_get_att_##SUFFIX(n, v, a, d); } \
+	static int PutAtt(int n, int v, const char* a, size_t l, const type* d) { return nc_put_att_##SUFFIX(n, v, a, NCTYPE, l, d); } \
+};
+
+FMINC4_TYPED_API(NC_BYTE, signed char, schar)
+FMINC4_TYPED_API(NC_UBYTE, unsigned char, uchar)
+FMINC4_TYPED_API(NC_SHORT, short, short)
+FMINC4_TYPED_API(NC_USHORT, unsigned short, ushort)
+FMINC4_TYPED_API(NC_INT, int, int)
+FMINC4_TYPED_API(NC_UINT, unsigned int, uint)
+FMINC4_TYPED_API(NC_INT64, long long, longlong)
+FMINC4_TYPED_API(NC_UINT64, unsigned long long, ulonglong)
+FMINC4_TYPED_API(NC_FLOAT, float, float)
+FMINC4_TYPED_API(NC_DOUBLE, double, double)
+
+#undef FMINC4_TYPED_API
+
+// Typed functions for memory type T, whose C type may differ (e.g. long and long long) but has the same representation
+template<typename T, nc_type NCTYPE>
+struct nc_typed_access
+{
+	typedef nc_typed_api<NCTYPE> api;
+	typedef typename api::type ctype;
+
+	static_assert(sizeof(T) == sizeof(ctype), "memory type and library type differ in size");
+
+	static constexpr nc_type value = NCTYPE;
+
+	static int GetVar(int n, int v, T* d) { return api::GetVar(n, v, reinterpret_cast<ctype*>(d)); }
+	static int GetVar1(int n, int v, const size_t* i, T* d) { return api::GetVar1(n, v, i, reinterpret_cast<ctype*>(d)); }
+	static int GetVara(int n, int v, const size_t* s, const size_t* c, T* d) { return api::GetVara(n, v, s, c, reinterpret_cast<ctype*>(d)); }
+	static int GetVars(int n, int v, const size_t* s, const size_t* c, const ptrdiff_t* st, T* d) { return api::GetVars(n, v, s, c, st, reinterpret_cast<ctype*>(d)); }
+	static int PutVar(int n, int v, const T* d) { return api::PutVar(n, v, reinterpret_cast<const ctype*>(d)); }
+	static int PutVar1(int n, int v, const size_t* i, const T* d) { return api::PutVar1(n, v, i, reinterpret_cast<const ctype*>(d)); }
+	static int PutVara(int n, int v, const size_t* s, const size_t* c, const T* d) { return api::PutVara(n, v, s, c, reinterpret_cast<const ctype*>(d)); }
+	static int GetAtt(int n, int v, const char* a, T* d) { return api::GetAtt(n, v, a, reinterpret_cast<ctype*>(d)); }
+	static int PutAtt(int n, int v, const char* a, size_t l, const T* d) { return api::PutAtt(n, v, a, l, reinterpret_cast<const ctype*>(d)); }
+};
+
+template<typename T, nc_type NCTYPE>
+constexpr nc_type nc_typed_access<T, NCTYPE>::value;
+
+// nc_type of integers by size and signedness
+template<size_t SIZE, bool SIGNED> struct nc_integer_type;
+template<> struct nc_integer_type<1, true> { static constexpr nc_type value = NC_BYTE; };
+template<> struct nc_integer_type<1, false> { static constexpr nc_type value = NC_UBYTE; };
+template<> struct nc_integer_type<2, true> { static constexpr nc_type value = NC_SHORT; };
+template<> struct nc_integer_type<2, false> { static constexpr nc_type value = NC_USHORT; };
+template<> struct nc_integer_type<4, true> { static constexpr nc_type value = NC_INT; };
+template<> struct nc_integer_type<4, false> { static constexpr nc_type value = NC_UINT; };
+template<> struct nc_integer_type<8, true> { static constexpr nc_type value = NC_INT64; };
+template<> struct nc_integer_type<8, false> { static constexpr nc_type value = NC_UINT64; };
+
+/*
+ * Natural nc_type of a C++ arithmetic type (value) and typed library functions for it.
+ * Undefined for types without a netcdf counterpart, such as bool and long double.
+ */
+
+template<typename T, typename = void>
+struct nc_traits;
+
+template<typename T>
+struct nc_traits<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>
+	: nc_typed_access<T, nc_integer_type<sizeof(T), std::is_signed<T>::value>::value> {};
+
+template<>
+struct nc_traits<float> : nc_typed_access<float, NC_FLOAT> {};
+
+template<>
+struct nc_traits<double> : nc_typed_access<double, NC_DOUBLE> {};
+
+// plain char is text, see AddTextAtt
+template<>
+struct nc_traits<char> { static constexpr nc_type value = NC_CHAR; };
+
+} // end namespace fminc4
+#endif /* TRAITS_H */
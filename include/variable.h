@@ -5,12 +5,44 @@
 #include <iostream>
 #include <vector>
 #include "fminc4.h"
+#include "traits.h"
+#include "packing.h"
+#include "stats.h"
+#include "coordinates.h"
+#include <future>
 #include <memory>
 
 namespace fminc4
 {
 
-extern std::mutex netcdfLibMutex;
+template<typename T> class nc_record_reader;
+template<typename T> class nc_record_appender;
+
+/*
+ * Read-only values of a whole variable. Points straight into the pages of a mapped file when the variable
+ * is stored contiguously, unfiltered and in native byte order, otherwise holds a copy. Keeps its memory alive on its own.
+ */
+
+template<typename T>
+class nc_view
+{
+	public:
+	nc_view() : itsSize(0), itsMapped(false) {}
+	nc_view(std::shared_ptr<const T> theData, size_t theSize, bool theMapped) : itsData(theData), itsSize(theSize), itsMapped(theMapped) {}
+
+	const T* Data() const { return itsData.get(); }
+	size_t Size() const { return itsSize; }
+	bool Mapped() const { return itsMapped; } // true if no copy was made
+
+	const T& operator[](size_t i) const { return itsData.get()[i]; }
+	const T* begin() const { return itsData.get(); }
+	const T* end() const { return itsData.get() + itsSize; }
+
+	private:
+	std::shared_ptr<const T> itsData;
+	size_t itsSize;
+	bool itsMapped;
+};
 
 class nc_var
 {
@@ -18,37 +50,131 @@ class nc_var
 	template<typename ATT_TYPE> struct type { };
 
         public:
-	nc_var() = default;
-	nc_var(int, int);
+	nc_var() : itsNcId(-1), itsVarId(-1), itsLayout(nullptr) {} // refers to no variable, calls throw NC_ENOTVAR
+	nc_var(std::shared_ptr<nc_file>, int, int); // layout is looked up from the metadata of the file
+	nc_var(std::shared_ptr<nc_file>, int, int, const nc_var_info*); // known layout, from nc_file::Layout
 
 	nc_type Type() const;
+	std::string Name() const;
 
 	// Write data to variable
 	template<typename T>
-        void Write(const std::vector<T>&); // Linear chunk of data in memory, size fill the entire variable. DON'T USE WITH UNLIMITED DIMENSION VARIABLES
+        void Write(const std::vector<T>&); // Linear chunk of data in memory, size fill the entire variable. DON'T USE WITH UNLIMITED DIMENSION VARIABLES, see Appender()
 
 	template<typename T>
         void Write(const std::vector<T>&, const std::vector<size_t>&, const std::vector<size_t>&); // Data is written to a subarray defined by starting indices and length in each dimension
 
 	template<typename T>
 	void Write(T, const std::vector<size_t>&);
+
+	template<typename T>
+	void Write(const T*, size_t); // Caller owned buffer of given length, fills the entire variable
+
+	template<typename T>
+	void Write(const T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&); // Caller owned buffer of given length written to a subarray
+
+	// Data is queued and written to a subarray by the background thread of the file. Takes over the buffer, future is ready once data is written.
+	// Queued writes are done in submission order but Read does not wait for them.
+	template<typename T>
+	std::future<void> WriteAsync(std::vector<T>&&, const std::vector<size_t>&, const std::vector<size_t>&);
 	//---
 
 	// Read data from variable
 	template<typename T>
 	std::vector<T> Read(); // Entire variable
 
+	// Non-throwing reads, failures are returned as the netcdf status of the result
+	template<typename T>
+	nc_result<std::vector<T>> TryRead(); // Entire variable
+
+	template<typename T>
+	nc_result<void> TryRead(T*, size_t); // Entire variable into caller owned buffer of given length
+
+	template<typename T>
+	nc_result<void> TryRead(T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&); // Subarray into caller owned buffer of given length
+
 	template<typename T>
         T Read(const std::vector<size_t>&); // Single value from index in N-dimensional index
 
 	template<typename T>
         std::vector<T> Read(const std::vector<size_t>&, const std::vector<size_t>&); // Read subarray defined by starting indices and length in each dimension to linear memory
+
+	template<typename T>
+	void Read(T*, size_t); // Entire variable into caller owned buffer of given length, nothing is allocated
+
+	template<typename T>
+	void Read(T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&); // Subarray into caller owned buffer of given length
+
+	template<typename T>
+	std::vector<T> Read(const std::vector<size_t>&, const std::vector<size_t>&, const std::vector<ptrdiff_t>&); // Every stride:th element along each dimension, count elements from start
+
+	template<typename T>
+	void Read(T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&, const std::vector<ptrdiff_t>&); // Strided subarray into caller owned buffer of given length
+
+	// Subarray selected by values of coordinate variables, e.g. nc_selection().Range("lat", 60, 70).Nearest("time", t).
+	// Coordinates are read once per file and searched, the subarray is read with one call. Empty if a range holds no values.
+	template<typename T>
+	std::vector<T> Read(const nc_selection&);
+
+	template<typename T>
+	nc_result<std::vector<T>> TryRead(const nc_selection&);
+
+	// Start and count of the subarray a selection refers to. NC_EBADDIM for dimensions the variable does not have,
+	// NC_ENOTVAR for values of dimensions without a coordinate variable, NC_EINVAL for coordinates that are not monotonic
+	// and NC_EINVALCOORDS for indexes out of range.
+	nc_result<void> TryResolve(const nc_selection&, std::vector<size_t>&, std::vector<size_t>&);
+	void Resolve(const nc_selection&, std::vector<size_t>&, std::vector<size_t>&);
+
+	// Coordinate variable values of the given dimension of the variable, nullptr if the dimension has none
+	std::shared_ptr<const nc_coordinate> Coordinate(size_t theDim);
+
+	// Values at scattered N-dimensional indices, in the order given. Points are grouped by storage chunk and each group is read at once.
+	template<typename T>
+	std::vector<T> Gather(const std::vector<std::vector<size_t>>&);
+
+	template<typename T>
+	void Gather(T*, size_t, const std::vector<std::vector<size_t>>&); // Into caller owned buffer of given length
+
+	// CF packed data: values are unpacked with scale_factor and add_offset in the same pass as they are read, fill values become NaN. T is float or double.
+	template<typename T>
+	std::vector<T> ReadUnpacked(); // Entire variable
+
+	template<typename T>
+	std::vector<T> ReadUnpacked(const std::vector<size_t>&, const std::vector<size_t>&); // Subarray
+
+	template<typename T>
+	void ReadUnpacked(T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&); // Subarray into caller owned buffer of given length
+
+	// Values are quantized with scale_factor and add_offset of the variable and written, NaN is written as fill value
+	template<typename T>
+	void WritePacked(const std::vector<T>&); // Entire variable
+
+	template<typename T>
+	void WritePacked(const T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&); // Subarray from caller owned buffer of given length
+
+	// Packing attributes of the variable, read with one lock
+	nc_packing Packing();
+
+	// Records along the first (unlimited) dimension, see records.h
+	template<typename T>
+	nc_record_reader<T> Records(size_t theBlock = 1, size_t theStart = 0); // Blocks of given number of records starting from given record
+
+	template<typename T>
+	nc_record_appender<T> Appender();
+
+	template<typename T>
+	nc_view<T> View(); // Entire variable without copying if the file was opened mapped and storage allows, see nc_view
 	//---
 
 	// Attributes
+	// Values converted to T from the type of the attribute, decoded attributes are cached in the file. T is one of the
+	// element types or std::string (text or string attributes).
         template<class T>
         std::vector<T> GetAtt(const std::string& name);
 
+	template<typename T>
+	nc_result<std::vector<T>> TryGetAtt(const std::string& name); // NC_ENOTATT if not found, nothing is thrown
+
 	template<typename T>
 	void AddAtt(const std::string&, const std::vector<T>&);
 
@@ -57,6 +183,8 @@ class nc_var
 
 	void AddTextAtt(const std::string&, const std::string&);
 
+	void AddAtt(const std::string&, const std::vector<std::string>&); // NC_STRING attribute
+
 	// return a list of attributes linked to the variable together with the attributes type and length
 	std::vector<std::tuple<std::string, nc_type, size_t>> ListAtts() const;
 
@@ -65,38 +193,54 @@ class nc_var
 	// Dimensions
 	std::vector<nc_dim> GetDims();
 
+	// Length of each dimension
+	std::vector<size_t> Shape();
+	nc_result<std::vector<size_t>> TryShape();
+
+	// HDF5 chunk cache of this variable: bytes, hash slots and preemption (0...1)
+	void ChunkCache(size_t, size_t, float);
+
+	// Independent or collective reads and writes of this variable, files opened with CreatePar or OpenPar only
+	void ParAccess(NcParAccess);
+
         private:
+	size_t Length(); // Number of elements in the entire variable
+	const nc_var_info& Info(const nc_metadata&) const; // Cached description of this variable
+	const nc_var_info& Layout() const; // throws NC_ENOTVAR for handles that refer to no variable
+	nc_result<std::shared_ptr<const nc_coordinate>> TryCoordinate(size_t); // nullptr if the dimension has no coordinate variable
+
+	template<typename T>
+	bool CachedRead(T*, const std::vector<size_t>&, const std::vector<size_t>&, int&); // Serve small read from block cache of the file, false if not applicable. Status of the read goes to the last argument
+	template<typename T>
+	bool ChunkedRead(T*, const std::vector<size_t>&, int&); // Entire variable of given shape through the parallel chunk engine of the file, false if not applicable
+	template<typename T>
+	bool ChunkedWrite(const T*);
+	void Written(); // Drop cached blocks and coordinate values after write
+	void PutAtt(const std::string&, nc_type, size_t theLength, size_t theSize, const void*); // Out of line so that instrumentation does not depend on how clients are built
+	const void* Mapped(size_t theBytes); // Address of data of the variable in mapped file, nullptr if not applicable
 
+	std::shared_ptr<nc_file> itsFile;
 	int itsNcId;
         int itsVarId;
+
+	// Name, type and dimensions, which do not change once the variable is defined. Kept by the file, which itsFile keeps
+	// alive, so copies of the handle only count references to the file. Attributes do change and are looked up from the
+	// current snapshot.
+	const nc_var_info* itsLayout;
 };
 
 //Implementation in header as otherwise all permutations of T and ATT_TYPE needed to be explicitly instantiated
 template <typename T>
 void nc_var::AddAtt(const std::string& name, const T& value)
 {
-        // ensure thread safety
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
-
-        int status = NC_NOERR;
-
-        if(std::is_same<T, double>::value)
-        {
-                status = nc_put_att(itsNcId, itsVarId, name.c_str(), NC_DOUBLE, 1, &value);
-        }
-        else if(std::is_same<T, float>::value)
-        {
-                status = nc_put_att(itsNcId, itsVarId, name.c_str(), NC_FLOAT, 1, &value);
-        }
-        else
-        {
-                std::cout << name << " attribute: unknown type\n";
-        }
-
-        if(status != NC_NOERR)
-	{
-                throw status;
-	}
+	// attribute gets the natural type of T, see nc_traits
+	PutAtt(name, nc_traits<T>::value, 1, sizeof(T), &value);
+}
+
+template <typename T>
+void nc_var::AddAtt(const std::string& name, const std::vector<T>& values)
+{
+	PutAtt(name, nc_traits<T>::value, values.size(), sizeof(T), values.data());
 }
 
 } // end namespace fminc4
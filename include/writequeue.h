@@ -0,0 +1,109 @@
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <netcdf.h>
+#include "traits.h"
+
+namespace fminc4
+{
+
+struct nc_file;
+
+// Hyperslab write waiting in the queue. Owns its data buffer.
+struct nc_write_request
+{
+	nc_write_request(int theNcId, int theVarId, const std::vector<size_t>& theStart, const std::vector<size_t>& theCount);
+	virtual ~nc_write_request() = default;
+
+	// Absorb the following request if both hyperslabs together form one contiguous hyperslab in memory and in file
+	bool Merge(nc_write_request&);
+
+	// Issue the library call, returns netcdf status
+	virtual int Put() = 0;
+
+	// Bytes held by the request
+	virtual size_t Size() const = 0;
+
+	int itsNcId;
+	int itsVarId;
+	std::vector<size_t> itsStart;
+	std::vector<size_t> itsCount;
+	std::vector<std::promise<void>> itsPromises; // completion of this and every merged request
+
+	protected:
+	// Concatenate data buffer of another request of the same element type to own buffer
+	virtual bool Append(nc_write_request&) = 0;
+};
+
+template<typename T>
+struct nc_typed_write_request : public nc_write_request
+{
+	nc_typed_write_request(int theNcId, int theVarId, std::vector<T>&& theData, const std::vector<size_t>& theStart, const std::vector<size_t>& theCount)
+		: nc_write_request(theNcId, theVarId, theStart, theCount), itsData(std::move(theData)) {}
+
+	int Put() override
+	{
+		return nc_traits<T>::PutVara(itsNcId, itsVarId, itsStart.data(), itsCount.data(), itsData.data());
+	}
+
+	size_t Size() const override
+	{
+		return itsData.size() * sizeof(T);
+	}
+
+	std::vector<T> itsData;
+
+	protected:
+	bool Append(nc_write_request& theOther) override
+	{
+		auto other = dynamic_cast<nc_typed_write_request<T>*>(&theOther);
+		if(!other)
+			return false;
+
+		itsData.insert(itsData.end(), std::make_move_iterator(other->itsData.begin()), std::make_move_iterator(other->itsData.end()));
+		return true;
+	}
+};
+
+/*
+ * Queue of pending writes served by a background thread, one per nc_file.
+ * Requests are written in submission order, adjacent hyperslabs of the same variable are merged into a single library call.
+ */
+
+class nc_write_queue
+{
+	public:
+	nc_write_queue(nc_file&);
+	~nc_write_queue(); // writes everything still queued before returning
+
+	nc_write_queue(const nc_write_queue&) = delete;
+	nc_write_queue& operator=(const nc_write_queue&) = delete;
+
+	std::future<void> Push(std::unique_ptr<nc_write_request>);
+
+	// Block until every request queued so far has been written
+	void Drain();
+
+	private:
+	void Run();
+
+	nc_file& itsFile;
+	std::mutex itsMutex;
+	std::condition_variable itsWork;
+	std::condition_variable itsIdle;
+	std::deque<std::unique_ptr<nc_write_request>> itsQueue;
+	bool itsBusy;
+	bool itsStop;
+	std::thread itsThread;
+};
+
+} // end namespace fminc4
+#endif /* WRITEQUEUE_H */
@@ -0,0 +1,244 @@
+#include "attributes.h"
+#include "fminc4.h"
+#include "traits.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace fminc4
+{
+
+// Bytes per value of atomic types other than NC_STRING, 0 for the rest
+static size_t TypeSize(nc_type theType)
+{
+	switch(theType)
+	{
+		case NC_BYTE:
+		case NC_UBYTE:
+		case NC_CHAR:
+			return 1;
+		case NC_SHORT:
+		case NC_USHORT:
+			return 2;
+		case NC_INT:
+		case NC_UINT:
+		case NC_FLOAT:
+			return 4;
+		case NC_INT64:
+		case NC_UINT64:
+		case NC_DOUBLE:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+int ReadAtt(int theNcId, int theVarId, const std::string& theName, nc_att_schema& theAtt)
+{
+	int status = nc_inq_att(theNcId, theVarId, theName.c_str(), &theAtt.itsType, &theAtt.itsLength);
+	if(status != NC_NOERR)
+		return status;
+
+	theAtt.itsName = theName;
+	theAtt.itsValues.clear();
+	theAtt.itsStrings.clear();
+
+	if(theAtt.itsType == NC_STRING)
+	{
+		std::vector<char*> values(theAtt.itsLength);
+		status = nc_get_att_string(theNcId, theVarId, theName.c_str(), values.data());
+		if(status != NC_NOERR)
+			return status;
+
+		for(const char* value : values)
+			theAtt.itsStrings.emplace_back(value ? value : "");
+
+		return nc_free_string(values.size(), values.data());
+	}
+
+	const size_t size = TypeSize(theAtt.itsType);
+
+	// user defined types cannot be copied as raw bytes
+	if(size == 0)
+		return NC_EBADTYPE;
+
+	theAtt.itsValues.resize(theAtt.itsLength * size);
+
+	return theAtt.itsLength == 0 ? NC_NOERR : nc_get_att(theNcId, theVarId, theName.c_str(), theAtt.itsValues.data());
+}
+
+int WriteAtt(int theNcId, int theVarId, const nc_att_schema& theAtt)
+{
+	switch(theAtt.itsType)
+	{
+		case NC_CHAR:
+			return nc_put_att_text(theNcId, theVarId, theAtt.itsName.c_str(), theAtt.itsLength, reinterpret_cast<const char*>(theAtt.itsValues.data()));
+		case NC_STRING:
+		{
+			std::vector<const char*> values;
+			for(const std::string& value : theAtt.itsStrings)
+				values.push_back(value.c_str());
+
+			return nc_put_att_string(theNcId, theVarId, theAtt.itsName.c_str(), values.size(), values.data());
+		}
+		default:
+			return nc_put_att(theNcId, theVarId, theAtt.itsName.c_str(), theAtt.itsType, theAtt.itsLength, theAtt.itsValues.data());
+	}
+}
+
+// Value of the attribute type fits in T, as libnetcdf checks it before converting (NC_ERANGE otherwise)
+template<typename T, typename S>
+static bool Representable(S theValue)
+{
+	if(std::is_floating_point<T>::value)
+	{
+		if(std::is_integral<S>::value || sizeof(T) >= sizeof(S) || !std::isfinite(theValue))
+			return true;
+
+		return std::fabs(static_cast<long double>(theValue)) <= std::numeric_limits<T>::max();
+	}
+
+	if(std::is_floating_point<S>::value)
+	{
+		// NaN fails both comparisons
+		const long double value = theValue;
+		const long double bound = std::ldexp(1.0L, std::numeric_limits<T>::digits);
+		return value >= (std::is_signed<T>::value ? -bound : 0.0L) && value < bound;
+	}
+
+	if(std::is_signed<S>::value && static_cast<intmax_t>(theValue) < 0)
+		return std::is_signed<T>::value && static_cast<intmax_t>(theValue) >= static_cast<intmax_t>(std::numeric_limits<T>::lowest());
+
+	return static_cast<uintmax_t>(theValue) <= static_cast<uintmax_t>(std::numeric_limits<T>::max());
+}
+
+template<nc_type NCTYPE, typename T>
+static int Convert(const nc_att_schema& theAtt, std::vector<T>& theValues)
+{
+	typedef typename nc_typed_api<NCTYPE>::type source;
+
+	theValues.resize(theAtt.itsLength);
+
+	for(size_t i = 0; i < theAtt.itsLength; ++i)
+	{
+		source value;
+		std::memcpy(&value, theAtt.itsValues.data() + i * sizeof(source), sizeof(source));
+
+		if(!Representable<T>(value))
+		{
+			theValues.clear();
+			return NC_ERANGE;
+		}
+
+		theValues[i] = static_cast<T>(value);
+	}
+
+	return NC_NOERR;
+}
+
+template<typename T>
+int ConvertAtt(const nc_att_schema& theAtt, std::vector<T>& theValues)
+{
+	switch(theAtt.itsType)
+	{
+		case NC_BYTE: return Convert<NC_BYTE>(theAtt, theValues);
+		case NC_UBYTE: return Convert<NC_UBYTE>(theAtt, theValues);
+		case NC_SHORT: return Convert<NC_SHORT>(theAtt, theValues);
+		case NC_USHORT: return Convert<NC_USHORT>(theAtt, theValues);
+		case NC_INT: return Convert<NC_INT>(theAtt, theValues);
+		case NC_UINT: return Convert<NC_UINT>(theAtt, theValues);
+		case NC_INT64: return Convert<NC_INT64>(theAtt, theValues);
+		case NC_UINT64: return Convert<NC_UINT64>(theAtt, theValues);
+		case NC_FLOAT: return Convert<NC_FLOAT>(theAtt, theValues);
+		case NC_DOUBLE: return Convert<NC_DOUBLE>(theAtt, theValues);
+		case NC_CHAR:
+		case NC_STRING:
+			return NC_ECHAR;
+		default:
+			return NC_EBADTYPE;
+	}
+}
+#define INSTANTIATE(T) template int ConvertAtt<T>(const nc_att_schema&, std::vector<T>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template<>
+int ConvertAtt(const nc_att_schema& theAtt, std::vector<std::string>& theValues)
+{
+	switch(theAtt.itsType)
+	{
+		case NC_CHAR:
+		{
+			// text written from C often carries its terminator
+			size_t length = theAtt.itsValues.size();
+			while(length > 0 && theAtt.itsValues[length - 1] == 0)
+				--length;
+
+			theValues.assign(1, std::string(reinterpret_cast<const char*>(theAtt.itsValues.data()), length));
+			return NC_NOERR;
+		}
+		case NC_STRING:
+			theValues = theAtt.itsStrings;
+			return NC_NOERR;
+		default:
+			return TypeSize(theAtt.itsType) == 0 ? NC_EBADTYPE : NC_ECHAR;
+	}
+}
+
+template<typename T>
+nc_result<std::vector<T>> AttValues(nc_file& theFile, int theNcId, int theVarId, const std::string& theName)
+{
+	nc_att_cache& cache = theFile.AttCache();
+
+	std::shared_ptr<const nc_att_schema> att = cache.Find(theNcId, theVarId, theName);
+	if(!att)
+	{
+		auto lock = theFile.Lock();
+
+		std::shared_ptr<nc_att_schema> read = std::make_shared<nc_att_schema>();
+		int status = ReadAtt(theNcId, theVarId, theName, *read);
+		if(status != NC_NOERR)
+			return nc_failure(status);
+
+		// inserted under the lock so that a concurrent AddAtt cannot be followed by a stale value
+		cache.Insert(theNcId, theVarId, read);
+		att = read;
+	}
+
+	std::vector<T> ret;
+	int status = ConvertAtt(*att, ret);
+	if(status != NC_NOERR)
+		return nc_failure(status);
+
+	return ret;
+}
+#define INSTANTIATE(T) template nc_result<std::vector<T>> AttValues<T>(nc_file&, int, int, const std::string&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+INSTANTIATE(std::string)
+#undef INSTANTIATE
+
+std::shared_ptr<const nc_att_schema> nc_att_cache::Find(int theNcId, int theVarId, const std::string& theName) const
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	auto it = itsAtts.find(key(theNcId, theVarId, theName));
+	return it == itsAtts.end() ? nullptr : it->second;
+}
+
+void nc_att_cache::Insert(int theNcId, int theVarId, std::shared_ptr<const nc_att_schema> theAtt)
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	itsAtts[key(theNcId, theVarId, theAtt->itsName)] = theAtt;
+}
+
+void nc_att_cache::Clear()
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	itsAtts.clear();
+}
+
+} // end namespace fminc4
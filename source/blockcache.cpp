@@ -0,0 +1,238 @@
+#include "blockcache.h"
+#include "chunking.h"
+#include "fminc4.h"
+#include "hyperslab.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace fminc4
+{
+
+nc_block_cache::nc_block_cache(nc_file& theFile, size_t theCapacity) : itsFile(theFile), itsCapacity(theCapacity), itsSize(0), itsGeneration(0)
+{
+}
+
+std::string nc_block_cache::Key(int theNcId, int theVarId, const std::vector<size_t>& theIndex)
+{
+	std::string ret(2 * sizeof(int) + theIndex.size() * sizeof(size_t), '\0');
+
+	std::memcpy(&ret[0], &theNcId, sizeof(int));
+	std::memcpy(&ret[sizeof(int)], &theVarId, sizeof(int));
+	if(!theIndex.empty())
+		std::memcpy(&ret[2 * sizeof(int)], theIndex.data(), theIndex.size() * sizeof(size_t));
+
+	return ret;
+}
+
+/*
+ * Blocks follow the chunks of chunked variables so that a block is decoded from exactly one chunk.
+ * Contiguous variables are divided into horizontal fields.
+ */
+
+int nc_block_cache::Layout(std::unique_lock<std::mutex>& theLock, int theNcId, int theVarId, const std::vector<size_t>& theShape, layout& theLayout)
+{
+	auto it = itsLayouts.find(var_key(theNcId, theVarId));
+	if(it != itsLayouts.end())
+	{
+		theLayout = it->second;
+		return NC_NOERR;
+	}
+
+	const size_t generation = itsGeneration;
+
+	theLock.unlock();
+
+	int status;
+	{
+		auto lock = itsFile.Lock();
+
+		status = nc_inq_vartype(theNcId, theVarId, &theLayout.itsType);
+		if(status == NC_NOERR)
+			status = nc_inq_type(theNcId, theLayout.itsType, NULL, &theLayout.itsElementSize);
+		if(status == NC_NOERR)
+			status = StorageBlock(theNcId, theVarId, theShape, theLayout.itsElementSize, theLayout.itsBlock);
+	}
+
+	theLock.lock();
+
+	// file may have been redefined meanwhile, the layout is used for this read only
+	if(status == NC_NOERR && generation == itsGeneration)
+		itsLayouts[var_key(theNcId, theVarId)] = theLayout;
+
+	return status;
+}
+
+void nc_block_cache::Drop(entry theEntry)
+{
+	itsSize -= theEntry->itsData.size();
+	itsIndex.erase(Key(theEntry->itsNcId, theEntry->itsVarId, theEntry->itsIndex));
+	itsBlocks.erase(theEntry);
+}
+
+/*
+ * Cached block of given index, read if not cached. Edge blocks of record variables are shorter than the block
+ * size and a block read before the unlimited dimension grew (written through another variable) is read again.
+ * Blocks read while the cache was erased are returned in theScratch and not cached.
+ */
+
+const nc_block_cache::block* nc_block_cache::Fetch(std::unique_lock<std::mutex>& theLock, int theNcId, int theVarId, const layout& theLayout, const std::vector<size_t>& theIndex, const std::vector<size_t>& theShape, block& theScratch, int& theStatus)
+{
+	const std::string key = Key(theNcId, theVarId, theIndex);
+
+	std::vector<size_t> start(theIndex.size()), count(theIndex.size());
+
+	for(size_t i = 0; i < theIndex.size(); ++i)
+	{
+		start[i] = theIndex[i] * theLayout.itsBlock[i];
+		count[i] = std::min(theLayout.itsBlock[i], theShape[i] - start[i]);
+	}
+
+	auto it = itsIndex.find(key);
+	if(it != itsIndex.end())
+	{
+		if(it->second->itsCount == count)
+		{
+			itsBlocks.splice(itsBlocks.begin(), itsBlocks, it->second);
+			return &*it->second;
+		}
+
+		Drop(it->second);
+	}
+
+	block b;
+	b.itsNcId = theNcId;
+	b.itsVarId = theVarId;
+	b.itsIndex = theIndex;
+	b.itsStart = start;
+	b.itsCount = count;
+	b.itsData.resize(Volume(b.itsCount) * theLayout.itsElementSize);
+
+	const size_t generation = itsGeneration;
+
+	theLock.unlock();
+	{
+		auto lock = itsFile.Lock();
+		theStatus = nc_get_vara(theNcId, theVarId, b.itsStart.data(), b.itsCount.data(), b.itsData.data());
+	}
+	theLock.lock();
+
+	if(theStatus != NC_NOERR)
+		return nullptr;
+
+	if(generation != itsGeneration)
+	{
+		theScratch = std::move(b);
+		return &theScratch;
+	}
+
+	// another thread read the same block meanwhile
+	it = itsIndex.find(key);
+	if(it != itsIndex.end())
+		Drop(it->second);
+
+	itsBlocks.push_front(std::move(b));
+	itsSize += itsBlocks.front().itsData.size();
+	itsIndex[key] = itsBlocks.begin();
+
+	// evict least recently used, the block just read is kept even if larger than capacity until the next read
+	while(itsSize > itsCapacity && itsBlocks.size() > 1)
+		Drop(std::prev(itsBlocks.end()));
+
+	return &itsBlocks.front();
+}
+
+int nc_block_cache::Read(int theNcId, int theVarId, const std::vector<size_t>& theShape, const std::vector<size_t>& theStart, const std::vector<size_t>& theCount, void* theData)
+{
+	std::unique_lock<std::mutex> lock(itsMutex);
+
+	layout l;
+	int status = Layout(lock, theNcId, theVarId, theShape, l);
+	if(status != NC_NOERR)
+		return status;
+
+	if(theStart.size() != theShape.size() || theCount.size() != theShape.size() || Volume(theCount) > Volume(l.itsBlock))
+		return NC_EINVAL;
+
+	for(size_t i = 0; i < theShape.size(); ++i)
+	{
+		if(theCount[i] == 0)
+			return NC_NOERR;
+
+		if(theStart[i] + theCount[i] > theShape[i])
+			return NC_EEDGE;
+	}
+
+	// first and last block along each dimension
+	const size_t n = theShape.size();
+	std::vector<size_t> first(n), last(n);
+
+	for(size_t i = 0; i < n; ++i)
+	{
+		first[i] = theStart[i] / l.itsBlock[i];
+		last[i] = (theStart[i] + theCount[i] - 1) / l.itsBlock[i];
+	}
+
+	std::vector<size_t> index(first);
+	std::vector<size_t> start, count;
+	block scratch;
+
+	while(true)
+	{
+		const block* b = Fetch(lock, theNcId, theVarId, l, index, theShape, scratch, status);
+		if(!b)
+			return status;
+
+		// block does not cover its part of the request, caller reads directly
+		if(!Intersect(b->itsStart, b->itsCount, theStart, theCount, start, count))
+			return NC_EINVAL;
+
+		CopyHyperslab(b->itsData.data(), b->itsStart, b->itsCount, theData, theStart, theCount, start, count, l.itsElementSize);
+
+		// next block
+		size_t i = n;
+		while(i > 0)
+		{
+			--i;
+			if(++index[i] <= last[i])
+				break;
+
+			index[i] = first[i];
+			if(i == 0)
+				return NC_NOERR;
+		}
+
+		if(n == 0)
+			return NC_NOERR;
+	}
+}
+
+void nc_block_cache::Erase(int theNcId, int theVarId)
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	++itsGeneration;
+
+	for(auto it = itsBlocks.begin(); it != itsBlocks.end();)
+	{
+		auto next = std::next(it);
+		if(it->itsNcId == theNcId && it->itsVarId == theVarId)
+			Drop(it);
+
+		it = next;
+	}
+}
+
+void nc_block_cache::Clear()
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	++itsGeneration;
+
+	itsLayouts.clear();
+	itsBlocks.clear();
+	itsIndex.clear();
+	itsSize = 0;
+}
+
+} // end namespace
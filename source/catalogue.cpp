@@ -0,0 +1,585 @@
+#include "catalogue.h"
+#include "attributes.h"
+#include "fminc4.h"
+#include "mapping.h"
+#include "metadata.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fminc4
+{
+
+const char* const kNcCatalogueSuffix = ".fmcat";
+
+nc_catalogue::nc_catalogue() : itsSourceSize(0), itsSourceTime(0) {}
+
+void nc_catalogue::Walk(nc_catalogue_visitor& theVisitor) const
+{
+	for(size_t i = 0; i < itsGroups.size();)
+	{
+		const nc_catalogue_group& group = itsGroups[i];
+		if(!theVisitor.Group(*this, group))
+		{
+			i = group.itsNext;
+			continue;
+		}
+
+		for(size_t a = 0; a < group.itsAtts; ++a)
+			theVisitor.Att(*this, group, nullptr, itsAtts[group.itsFirstAtt + a]);
+
+		for(size_t d = 0; d < group.itsDims; ++d)
+			theVisitor.Dim(*this, group, itsDims[group.itsFirstDim + d]);
+
+		for(size_t v = 0; v < group.itsVars; ++v)
+		{
+			const nc_catalogue_var& var = itsVars[group.itsFirstVar + v];
+			theVisitor.Var(*this, group, var);
+
+			for(size_t a = 0; a < var.itsAtts; ++a)
+				theVisitor.Att(*this, group, &var, itsAtts[var.itsFirstAtt + a]);
+		}
+
+		++i;
+	}
+}
+
+int nc_catalogue::Group(const std::string& thePath) const
+{
+	for(size_t i = 0; i < itsGroups.size(); ++i)
+	{
+		if(itsGroups[i].itsPath == thePath)
+			return static_cast<int>(i);
+	}
+
+	return -1;
+}
+
+int nc_catalogue::Var(int theGroup, const std::string& theName) const
+{
+	if(theGroup < 0 || theGroup >= static_cast<int>(itsGroups.size()))
+		return -1;
+
+	const nc_catalogue_group& group = itsGroups[theGroup];
+	for(size_t i = group.itsFirstVar; i < group.itsFirstVar + group.itsVars; ++i)
+	{
+		if(itsVars[i].itsName == theName)
+			return static_cast<int>(i);
+	}
+
+	return -1;
+}
+
+const nc_catalogue_dim& nc_catalogue::VarDim(const nc_catalogue_var& theVar, size_t theIndex) const
+{
+	return itsDims[itsVarDims[theVar.itsFirstDim + theIndex]];
+}
+
+std::vector<size_t> nc_catalogue::Shape(const nc_catalogue_var& theVar) const
+{
+	std::vector<size_t> ret;
+	ret.reserve(theVar.itsDims);
+
+	for(size_t i = 0; i < theVar.itsDims; ++i)
+		ret.push_back(VarDim(theVar, i).itsLength);
+
+	return ret;
+}
+
+/*
+ * Sidecar format: magic, version and byte order mark, then every array as a count followed by its records. Numbers
+ * are written as they are in memory, a sidecar written on a machine of other byte order is rejected and rebuilt.
+ */
+
+static const char kMagic[8] = {'F', 'M', 'I', 'N', 'C', '4', 'C', 'T'};
+static const uint32_t kVersion = 1;
+static const uint32_t kByteOrder = 0x01020304;
+
+class sidecar_writer
+{
+	public:
+	template<typename T>
+	void Put(T theValue)
+	{
+		itsBuffer.append(reinterpret_cast<const char*>(&theValue), sizeof(T));
+	}
+
+	void Put(const std::string& theValue)
+	{
+		Put(static_cast<uint32_t>(theValue.size()));
+		itsBuffer.append(theValue);
+	}
+
+	void Put(const char* theData, size_t theSize)
+	{
+		itsBuffer.append(theData, theSize);
+	}
+
+	const std::string& Buffer() const
+	{
+		return itsBuffer;
+	}
+
+	private:
+	std::string itsBuffer;
+};
+
+// Reads fail once past the end of the data, callers check Ok() at the end
+class sidecar_reader
+{
+	public:
+	sidecar_reader(const char* theData, size_t theSize) : itsData(theData), itsSize(theSize), itsPos(0), itsOk(true) {}
+
+	template<typename T>
+	T Get()
+	{
+		T ret = T();
+		if(Take(sizeof(T)))
+			std::memcpy(&ret, itsData + itsPos - sizeof(T), sizeof(T));
+		return ret;
+	}
+
+	size_t Size()
+	{
+		return static_cast<size_t>(Get<uint64_t>());
+	}
+
+	std::string String()
+	{
+		const size_t len = Get<uint32_t>();
+		return Take(len) ? std::string(itsData + itsPos - len, len) : std::string();
+	}
+
+	// Count of records, each at least theMinSize bytes. Counts larger than the rest of the data fail.
+	size_t Count(size_t theMinSize)
+	{
+		const size_t ret = Size();
+		if(ret > (itsSize - itsPos) / theMinSize)
+		{
+			itsOk = false;
+			return 0;
+		}
+		return ret;
+	}
+
+	bool Take(size_t theSize)
+	{
+		if(!itsOk || theSize > itsSize - itsPos)
+		{
+			itsOk = false;
+			return false;
+		}
+		itsPos += theSize;
+		return true;
+	}
+
+	const char* Data() const
+	{
+		return itsData + itsPos;
+	}
+
+	bool Ok() const
+	{
+		return itsOk && itsPos == itsSize;
+	}
+
+	private:
+	const char* itsData;
+	size_t itsSize;
+	size_t itsPos;
+	bool itsOk;
+};
+
+static void PutAtt(sidecar_writer& theWriter, const nc_att_schema& theAtt)
+{
+	theWriter.Put(theAtt.itsName);
+	theWriter.Put(static_cast<int32_t>(theAtt.itsType));
+	theWriter.Put(static_cast<uint64_t>(theAtt.itsLength));
+	theWriter.Put(static_cast<uint64_t>(theAtt.itsValues.size()));
+	theWriter.Put(reinterpret_cast<const char*>(theAtt.itsValues.data()), theAtt.itsValues.size());
+	theWriter.Put(static_cast<uint64_t>(theAtt.itsStrings.size()));
+	for(const std::string& value : theAtt.itsStrings)
+		theWriter.Put(value);
+}
+
+static nc_att_schema GetAtt(sidecar_reader& theReader)
+{
+	nc_att_schema ret;
+	ret.itsName = theReader.String();
+	ret.itsType = theReader.Get<int32_t>();
+	ret.itsLength = theReader.Size();
+
+	const size_t bytes = theReader.Count(1);
+	if(theReader.Take(bytes))
+		ret.itsValues.assign(theReader.Data() - bytes, theReader.Data());
+
+	const size_t strings = theReader.Count(sizeof(uint32_t));
+	ret.itsStrings.reserve(strings);
+	for(size_t i = 0; i < strings; ++i)
+		ret.itsStrings.push_back(theReader.String());
+
+	return ret;
+}
+
+static bool InRange(size_t theFirst, size_t theCount, size_t theSize)
+{
+	return theFirst <= theSize && theCount <= theSize - theFirst;
+}
+
+// Indexes of a loaded catalogue refer to records that exist
+static bool Valid(const nc_catalogue& theCatalogue)
+{
+	for(size_t i = 0; i < theCatalogue.itsGroups.size(); ++i)
+	{
+		const nc_catalogue_group& group = theCatalogue.itsGroups[i];
+		if(group.itsParent >= static_cast<int>(i) || group.itsNext <= i || group.itsNext > theCatalogue.itsGroups.size() ||
+		   !InRange(group.itsFirstDim, group.itsDims, theCatalogue.itsDims.size()) ||
+		   !InRange(group.itsFirstVar, group.itsVars, theCatalogue.itsVars.size()) ||
+		   !InRange(group.itsFirstAtt, group.itsAtts, theCatalogue.itsAtts.size()))
+			return false;
+	}
+
+	for(const nc_catalogue_var& var : theCatalogue.itsVars)
+	{
+		if(!InRange(var.itsFirstDim, var.itsDims, theCatalogue.itsVarDims.size()) || !InRange(var.itsFirstAtt, var.itsAtts, theCatalogue.itsAtts.size()))
+			return false;
+	}
+
+	for(size_t dim : theCatalogue.itsVarDims)
+	{
+		if(dim >= theCatalogue.itsDims.size())
+			return false;
+	}
+
+	return true;
+}
+
+void nc_catalogue::Save(const std::string& thePath) const
+{
+	sidecar_writer w;
+	w.Put(kMagic, sizeof(kMagic));
+	w.Put(kVersion);
+	w.Put(kByteOrder);
+	w.Put(itsSourceSize);
+	w.Put(itsSourceTime);
+
+	w.Put(static_cast<uint64_t>(itsGroups.size()));
+	for(const nc_catalogue_group& group : itsGroups)
+	{
+		w.Put(group.itsName);
+		w.Put(group.itsPath);
+		w.Put(static_cast<int32_t>(group.itsParent));
+		w.Put(static_cast<uint64_t>(group.itsNext));
+		w.Put(static_cast<uint64_t>(group.itsFirstDim));
+		w.Put(static_cast<uint64_t>(group.itsDims));
+		w.Put(static_cast<uint64_t>(group.itsFirstVar));
+		w.Put(static_cast<uint64_t>(group.itsVars));
+		w.Put(static_cast<uint64_t>(group.itsFirstAtt));
+		w.Put(static_cast<uint64_t>(group.itsAtts));
+	}
+
+	w.Put(static_cast<uint64_t>(itsDims.size()));
+	for(const nc_catalogue_dim& dim : itsDims)
+	{
+		w.Put(dim.itsName);
+		w.Put(static_cast<uint64_t>(dim.itsLength));
+		w.Put(static_cast<uint8_t>(dim.itsUnlimited));
+	}
+
+	w.Put(static_cast<uint64_t>(itsVarDims.size()));
+	for(size_t dim : itsVarDims)
+		w.Put(static_cast<uint64_t>(dim));
+
+	w.Put(static_cast<uint64_t>(itsVars.size()));
+	for(const nc_catalogue_var& var : itsVars)
+	{
+		w.Put(var.itsName);
+		w.Put(static_cast<int32_t>(var.itsType));
+		w.Put(static_cast<uint64_t>(var.itsFirstDim));
+		w.Put(static_cast<uint64_t>(var.itsDims));
+		w.Put(static_cast<uint64_t>(var.itsFirstAtt));
+		w.Put(static_cast<uint64_t>(var.itsAtts));
+	}
+
+	w.Put(static_cast<uint64_t>(itsAtts.size()));
+	for(const nc_att_schema& att : itsAtts)
+		PutAtt(w, att);
+
+	// readers of the sidecar see the old or the new file, never a partial one
+	ReplaceFile(thePath, w.Buffer());
+}
+
+nc_result<nc_catalogue> nc_catalogue::Load(const std::string& thePath)
+{
+	int fd = open(thePath.c_str(), O_RDONLY);
+	if(fd < 0)
+		return nc_failure(errno);
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		int error = errno;
+		close(fd);
+		return nc_failure(error);
+	}
+
+	std::vector<char> buffer(static_cast<size_t>(st.st_size));
+	for(size_t pos = 0; pos < buffer.size();)
+	{
+		ssize_t n = read(fd, buffer.data() + pos, buffer.size() - pos);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+		{
+			int error = n < 0 ? errno : NC_ENOTNC;
+			close(fd);
+			return nc_failure(error);
+		}
+		pos += static_cast<size_t>(n);
+	}
+	close(fd);
+
+	sidecar_reader r(buffer.data(), buffer.size());
+
+	if(!r.Take(sizeof(kMagic)) || std::memcmp(buffer.data(), kMagic, sizeof(kMagic)) != 0 || r.Get<uint32_t>() != kVersion || r.Get<uint32_t>() != kByteOrder)
+		return nc_failure(NC_ENOTNC);
+
+	nc_catalogue ret;
+	ret.itsSourceSize = r.Get<uint64_t>();
+	ret.itsSourceTime = r.Get<uint64_t>();
+
+	ret.itsGroups.resize(r.Count(2 * sizeof(uint32_t) + sizeof(int32_t) + 7 * sizeof(uint64_t)));
+	for(nc_catalogue_group& group : ret.itsGroups)
+	{
+		group.itsName = r.String();
+		group.itsPath = r.String();
+		group.itsParent = r.Get<int32_t>();
+		group.itsNext = r.Size();
+		group.itsFirstDim = r.Size();
+		group.itsDims = r.Size();
+		group.itsFirstVar = r.Size();
+		group.itsVars = r.Size();
+		group.itsFirstAtt = r.Size();
+		group.itsAtts = r.Size();
+	}
+
+	ret.itsDims.resize(r.Count(sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint8_t)));
+	for(nc_catalogue_dim& dim : ret.itsDims)
+	{
+		dim.itsName = r.String();
+		dim.itsLength = r.Size();
+		dim.itsUnlimited = r.Get<uint8_t>() != 0;
+	}
+
+	ret.itsVarDims.resize(r.Count(sizeof(uint64_t)));
+	for(size_t& dim : ret.itsVarDims)
+		dim = r.Size();
+
+	ret.itsVars.resize(r.Count(sizeof(uint32_t) + sizeof(int32_t) + 4 * sizeof(uint64_t)));
+	for(nc_catalogue_var& var : ret.itsVars)
+	{
+		var.itsName = r.String();
+		var.itsType = r.Get<int32_t>();
+		var.itsFirstDim = r.Size();
+		var.itsDims = r.Size();
+		var.itsFirstAtt = r.Size();
+		var.itsAtts = r.Size();
+	}
+
+	const size_t atts = r.Count(sizeof(uint32_t) + sizeof(int32_t) + 3 * sizeof(uint64_t));
+	ret.itsAtts.reserve(atts);
+	for(size_t i = 0; i < atts; ++i)
+		ret.itsAtts.push_back(GetAtt(r));
+
+	if(!r.Ok() || !Valid(ret))
+		return nc_failure(NC_ENOTNC);
+
+	return ret;
+}
+
+/*
+ * Structure comes from the metadata snapshot of the file. Attribute values and the current length of unlimited
+ * dimensions are read afterwards holding the lock of the file once for the whole tree.
+ */
+
+struct catalogue_walk
+{
+	catalogue_walk(const nc_metadata& theMetadata) : itsMetadata(theMetadata) {}
+
+	void Group(int theGroupId, int theParent, const std::string& thePath);
+	void AddAtts(int theGroupId, int theVarId, const std::vector<nc_att_info>&);
+
+	const nc_metadata& itsMetadata;
+	nc_catalogue itsCatalogue;
+	std::vector<std::pair<int, int>> itsDimOwners; // group and dimension id by catalogue dimension
+	std::vector<std::pair<int, int>> itsAttOwners; // group and variable id by catalogue attribute
+	std::map<int, size_t> itsDimIndexes; // catalogue dimension by dimension id
+	std::vector<size_t> itsOutside; // variable dimensions (in itsVarDims) defined in parents of the walked group
+};
+
+void catalogue_walk::AddAtts(int theGroupId, int theVarId, const std::vector<nc_att_info>& theAtts)
+{
+	for(const nc_att_info& info : theAtts)
+	{
+		nc_att_schema att;
+		att.itsName = info.itsName;
+		att.itsType = info.itsType;
+		att.itsLength = info.itsLength;
+
+		itsCatalogue.itsAtts.push_back(att);
+		itsAttOwners.push_back(std::make_pair(theGroupId, theVarId));
+	}
+}
+
+void catalogue_walk::Group(int theGroupId, int theParent, const std::string& thePath)
+{
+	const nc_group_info* info = itsMetadata.Group(theGroupId);
+	if(!info)
+		throw nc_error(NC_ENOGRP);
+
+	const size_t index = itsCatalogue.itsGroups.size();
+	itsCatalogue.itsGroups.emplace_back();
+
+	nc_catalogue_group group;
+	group.itsName = info->itsName;
+	group.itsPath = thePath;
+	group.itsParent = theParent;
+
+	group.itsFirstAtt = itsCatalogue.itsAtts.size();
+	group.itsAtts = info->itsAtts.size();
+	AddAtts(theGroupId, NC_GLOBAL, info->itsAtts);
+
+	group.itsFirstDim = itsCatalogue.itsDims.size();
+	group.itsDims = info->itsDimIds.size();
+	for(int dimId : info->itsDimIds)
+	{
+		const nc_dim_info* dim = itsMetadata.Dim(dimId);
+		if(!dim)
+			throw nc_error(NC_EBADDIM);
+
+		nc_catalogue_dim entry;
+		entry.itsName = dim->itsName;
+		entry.itsLength = dim->itsLength;
+		entry.itsUnlimited = dim->itsUnlimited;
+
+		itsDimIndexes[dimId] = itsCatalogue.itsDims.size();
+		itsDimOwners.push_back(std::make_pair(theGroupId, dimId));
+		itsCatalogue.itsDims.push_back(entry);
+	}
+
+	group.itsFirstVar = itsCatalogue.itsVars.size();
+	group.itsVars = info->itsVars.size();
+	for(size_t varId = 0; varId < info->itsVars.size(); ++varId)
+	{
+		const nc_var_info& var = info->itsVars[varId];
+
+		nc_catalogue_var entry;
+		entry.itsName = var.itsName;
+		entry.itsType = var.itsType;
+		entry.itsFirstDim = itsCatalogue.itsVarDims.size();
+		entry.itsDims = var.itsDimIds.size();
+
+		// dimensions of this group and walked parents are in the catalogue already
+		for(int dimId : var.itsDimIds)
+		{
+			auto it = itsDimIndexes.find(dimId);
+			if(it == itsDimIndexes.end())
+			{
+				itsOutside.push_back(itsCatalogue.itsVarDims.size());
+				itsCatalogue.itsVarDims.push_back(static_cast<size_t>(dimId));
+			}
+			else
+				itsCatalogue.itsVarDims.push_back(it->second);
+		}
+
+		entry.itsFirstAtt = itsCatalogue.itsAtts.size();
+		entry.itsAtts = var.itsAtts.size();
+		AddAtts(theGroupId, static_cast<int>(varId), var.itsAtts);
+
+		itsCatalogue.itsVars.push_back(entry);
+	}
+
+	const std::string prefix = thePath == "/" ? thePath : thePath + "/";
+
+	for(int groupId : info->itsGroupIds)
+	{
+		const nc_group_info* sub = itsMetadata.Group(groupId);
+		if(!sub)
+			throw nc_error(NC_ENOGRP);
+
+		Group(groupId, static_cast<int>(index), prefix + sub->itsName);
+	}
+
+	group.itsNext = itsCatalogue.itsGroups.size();
+	itsCatalogue.itsGroups[index] = group;
+}
+
+nc_catalogue WalkGroup(nc_file& theFile, int theGroupId)
+{
+	auto metadata = theFile.Metadata();
+
+	const std::string path = metadata->Path(theGroupId);
+	if(path.empty())
+		throw nc_error(NC_ENOGRP);
+
+	catalogue_walk w(*metadata);
+	w.Group(theGroupId, -1, path);
+
+	nc_catalogue& ret = w.itsCatalogue;
+
+	// variables of a walked sub group may use dimensions of its parents
+	for(size_t varDim : w.itsOutside)
+	{
+		const int dimId = static_cast<int>(ret.itsVarDims[varDim]);
+
+		auto it = w.itsDimIndexes.find(dimId);
+		if(it == w.itsDimIndexes.end())
+		{
+			const nc_dim_info* dim = metadata->Dim(dimId);
+			if(!dim)
+				throw nc_error(NC_EBADDIM);
+
+			nc_catalogue_dim entry;
+			entry.itsName = dim->itsName;
+			entry.itsLength = dim->itsLength;
+			entry.itsUnlimited = dim->itsUnlimited;
+
+			// dimensions are found from parents of the group they are queried from
+			it = w.itsDimIndexes.insert(std::make_pair(dimId, ret.itsDims.size())).first;
+			w.itsDimOwners.push_back(std::make_pair(theGroupId, dimId));
+			ret.itsDims.push_back(entry);
+		}
+
+		ret.itsVarDims[varDim] = it->second;
+	}
+
+	auto lock = theFile.Lock();
+
+	// unlimited dimensions may have grown since the snapshot was taken
+	for(size_t i = 0; i < ret.itsDims.size(); ++i)
+	{
+		if(!ret.itsDims[i].itsUnlimited)
+			continue;
+
+		int status = nc_inq_dimlen(w.itsDimOwners[i].first, w.itsDimOwners[i].second, &ret.itsDims[i].itsLength);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+	}
+
+	for(size_t i = 0; i < ret.itsAtts.size(); ++i)
+	{
+		nc_att_schema& att = ret.itsAtts[i];
+
+		// attributes of user defined types are listed without values
+		int status = ReadAtt(w.itsAttOwners[i].first, w.itsAttOwners[i].second, att.itsName, att);
+		if(status != NC_NOERR && status != NC_EBADTYPE)
+			throw nc_error(status);
+	}
+
+	return std::move(ret);
+}
+
+} // end namespace fminc4
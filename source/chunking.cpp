@@ -0,0 +1,169 @@
+#include "chunking.h"
+#include <algorithm>
+#include <cmath>
+#include <netcdf_meta.h>
+
+#if defined(NC_HAS_ZSTD) && NC_HAS_ZSTD
+#include <netcdf_filter.h>
+#endif
+
+namespace fminc4
+{
+
+// A time slice chunk holds one horizontal field, split if larger than this
+const size_t kSliceChunkBytes = 4 * 1024 * 1024;
+
+// A time series chunk holds the whole series of a horizontal tile of about this size
+const size_t kSeriesChunkBytes = 1024 * 1024;
+
+// Time steps per chunk when the time dimension is unlimited and still empty
+const size_t kSeriesLength = 256;
+
+// Shrink chunk length so that chunks cover the dimension evenly instead of leaving a mostly empty last chunk
+static size_t Balance(size_t theExtent, size_t theLength)
+{
+	const size_t chunks = (theExtent + theLength - 1) / theLength;
+	return (theExtent + chunks - 1) / chunks;
+}
+
+/*
+ * Time slice: length one along time and levels, full extent of the two fastest varying (horizontal) dimensions.
+ * Time series: full extent of time, length one along levels and a square horizontal tile.
+ */
+
+std::vector<size_t> ChunkShape(const std::vector<size_t>& theLengths, size_t theTypeSize, NcAccessPattern theAccess)
+{
+	const size_t n = theLengths.size();
+
+	if(n == 0 || theAccess == kNcAccessDefault)
+		return std::vector<size_t>();
+
+	std::vector<size_t> ret(n, 1);
+
+	auto extent = [&](size_t i) { return std::max<size_t>(theLengths[i], 1); };
+	auto bytes = [&]()
+	{
+		size_t b = theTypeSize;
+		for(size_t x : ret)
+			b *= x;
+		return b;
+	};
+
+	if(theAccess == kNcAccessTimeSlice)
+	{
+		const size_t first = n > 2 ? n - 2 : 0;
+
+		for(size_t i = first; i < n; ++i)
+			ret[i] = extent(i);
+
+		// halve slowest varying horizontal dimension first to keep rows intact
+		for(size_t i = first; i < n; ++i)
+		{
+			while(bytes() > kSliceChunkBytes && ret[i] > 1)
+				ret[i] = (ret[i] + 1) / 2;
+
+			ret[i] = Balance(extent(i), ret[i]);
+		}
+
+		return ret;
+	}
+
+	// time series
+	const size_t steps = theLengths[0] == 0 ? kSeriesLength : theLengths[0];
+	ret[0] = std::max<size_t>(std::min(steps, kSeriesChunkBytes / theTypeSize), 1);
+
+	if(n == 1)
+		return ret;
+
+	const size_t tile = std::max<size_t>(kSeriesChunkBytes / bytes(), 1);
+
+	if(n == 2)
+	{
+		ret[1] = Balance(extent(1), std::min(tile, extent(1)));
+		return ret;
+	}
+
+	const size_t side = std::max<size_t>(static_cast<size_t>(std::sqrt(static_cast<double>(tile))), 1);
+	ret[n - 2] = Balance(extent(n - 2), std::min(side, extent(n - 2)));
+	ret[n - 1] = Balance(extent(n - 1), std::min(std::max<size_t>(tile / ret[n - 2], 1), extent(n - 1)));
+
+	return ret;
+}
+
+int StorageBlock(int theNcId, int theVarId, const std::vector<size_t>& theShape, size_t theElementSize, std::vector<size_t>& theBlock)
+{
+	theBlock.resize(theShape.size());
+
+	int storage = NC_CONTIGUOUS;
+	if(!theShape.empty())
+	{
+		int status = nc_inq_var_chunking(theNcId, theVarId, &storage, theBlock.data());
+		if(status != NC_NOERR)
+			return status;
+	}
+
+	if(storage != NC_CHUNKED)
+		theBlock = ChunkShape(theShape, theElementSize, kNcAccessTimeSlice);
+
+	return NC_NOERR;
+}
+
+int DefineStorage(int theNcId, int theVarId, const std::vector<size_t>& theLengths, nc_type theType, const nc_var_options& theOptions)
+{
+	int status = NC_NOERR;
+
+	std::vector<size_t> chunks = theOptions.itsChunks;
+
+	if(chunks.empty() && theOptions.itsAccess != kNcAccessDefault)
+	{
+		size_t typeSize;
+		status = nc_inq_type(theNcId, theType, NULL, &typeSize);
+		if(status != NC_NOERR)
+			return status;
+
+		chunks = ChunkShape(theLengths, typeSize, theOptions.itsAccess);
+	}
+
+	if(!chunks.empty())
+	{
+		if(chunks.size() != theLengths.size())
+			return NC_EINVAL;
+
+		status = nc_def_var_chunking(theNcId, theVarId, NC_CHUNKED, chunks.data());
+		if(status != NC_NOERR)
+			return status;
+	}
+
+	if(theOptions.itsQuantize != kNcQuantizeNone)
+	{
+#ifdef NC_QUANTIZE_BITGROOM
+		status = nc_def_var_quantize(theNcId, theVarId, theOptions.itsQuantize, theOptions.itsQuantizeDigits);
+		if(status != NC_NOERR)
+			return status;
+#else
+		return NC_ENOTBUILT;
+#endif
+	}
+
+	if(theOptions.itsShuffle || theOptions.itsDeflateLevel > 0)
+	{
+		status = nc_def_var_deflate(theNcId, theVarId, theOptions.itsShuffle, theOptions.itsDeflateLevel > 0, theOptions.itsDeflateLevel);
+		if(status != NC_NOERR)
+			return status;
+	}
+
+	if(theOptions.itsZstdLevel > 0)
+	{
+#if defined(NC_HAS_ZSTD) && NC_HAS_ZSTD
+		status = nc_def_var_zstandard(theNcId, theVarId, theOptions.itsZstdLevel);
+		if(status != NC_NOERR)
+			return status;
+#else
+		return NC_ENOTBUILT;
+#endif
+	}
+
+	return status;
+}
+
+} // end namespace
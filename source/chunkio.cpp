@@ -0,0 +1,543 @@
+#include "chunkio.h"
+#include "fminc4.h"
+#include "hyperslab.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <netcdf.h>
+
+#ifdef FMINC4_HAVE_HDF5
+#include <hdf5.h>
+#include <zlib.h>
+#endif
+
+namespace fminc4
+{
+
+#ifdef FMINC4_HAVE_HDF5
+
+namespace
+{
+
+struct filter
+{
+	H5Z_filter_t itsId;
+	int itsLevel; // deflate only
+};
+
+// Layout of a variable, shared by the tasks of one call
+struct layout
+{
+	std::vector<size_t> itsShape;
+	std::vector<size_t> itsChunk;
+	std::vector<filter> itsFilters; // in the order applied on write
+	size_t itsElementSize;
+	size_t itsChunkBytes;
+};
+
+/*
+ * Dataset of a variable opened through HDF5 next to the handle of the library. HDF5 shares an open file and its open
+ * datasets, chunk cache included, between handles, so chunks written here are seen by the library and vice versa.
+ * Opened and closed under the lock of the file.
+ */
+
+class dataset
+{
+	public:
+	dataset() : itsFile(-1), itsDataset(-1) {}
+
+	int Open(int theRootId, int theNcId, int theVarId, bool theWrite, layout& theLayout);
+	void Close();
+
+	hid_t Id() const { return itsDataset; }
+
+	private:
+	hid_t itsFile;
+	hid_t itsDataset;
+};
+
+} // end namespace
+
+static bool LittleEndian()
+{
+	const uint16_t one = 1;
+	return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+// Path of the file and full path of the variable inside it
+static int Paths(int theRootId, int theNcId, int theVarId, std::string& thePath, std::string& theVarPath)
+{
+	size_t len;
+	int status = nc_inq_path(theRootId, &len, NULL);
+	if(status != NC_NOERR)
+		return status;
+
+	std::vector<char> buffer(len + 1);
+	status = nc_inq_path(theRootId, &len, buffer.data());
+	if(status != NC_NOERR)
+		return status;
+
+	thePath.assign(buffer.data(), len);
+
+	status = nc_inq_grpname_full(theNcId, &len, NULL);
+	if(status != NC_NOERR)
+		return status;
+
+	buffer.resize(len + 1);
+	status = nc_inq_grpname_full(theNcId, &len, buffer.data());
+	if(status != NC_NOERR)
+		return status;
+
+	theVarPath.assign(buffer.data(), len);
+
+	char name[NC_MAX_NAME + 1];
+	status = nc_inq_varname(theNcId, theVarId, name);
+	if(status != NC_NOERR)
+		return status;
+
+	if(theVarPath.empty() || theVarPath[theVarPath.size() - 1] != '/')
+		theVarPath += '/';
+	theVarPath += name;
+
+	return NC_NOERR;
+}
+
+// Chunk shape and filters of the dataset, NC_EINVAL if chunks cannot be handled here
+static int Describe(hid_t theDataset, layout& theLayout)
+{
+	const size_t n = theLayout.itsShape.size();
+
+	hid_t type = H5Dget_type(theDataset);
+	if(type < 0)
+		return NC_EHDFERR;
+
+	const size_t size = H5Tget_size(type);
+	const H5T_order_t order = H5Tget_order(type);
+	H5Tclose(type);
+
+	if(size != theLayout.itsElementSize || (size > 1 && (order == H5T_ORDER_LE) != LittleEndian()))
+		return NC_EINVAL;
+
+	hid_t dcpl = H5Dget_create_plist(theDataset);
+	if(dcpl < 0)
+		return NC_EHDFERR;
+
+	int status = NC_NOERR;
+	std::vector<hsize_t> chunk(n);
+
+	if(n == 0 || H5Pget_layout(dcpl) != H5D_CHUNKED || H5Pget_chunk(dcpl, static_cast<int>(n), chunk.data()) != static_cast<int>(n))
+		status = NC_EINVAL;
+
+	const int filters = status == NC_NOERR ? H5Pget_nfilters(dcpl) : 0;
+
+	for(int i = 0; i < filters && status == NC_NOERR; ++i)
+	{
+		unsigned int flags;
+		unsigned int values[8];
+		size_t nvalues = 8;
+
+		filter f;
+		f.itsId = H5Pget_filter2(dcpl, static_cast<unsigned int>(i), &flags, &nvalues, values, 0, NULL, NULL);
+		f.itsLevel = f.itsId == H5Z_FILTER_DEFLATE && nvalues > 0 ? static_cast<int>(values[0]) : 0;
+
+		if(f.itsId != H5Z_FILTER_DEFLATE && f.itsId != H5Z_FILTER_SHUFFLE)
+			status = NC_EINVAL;
+
+		theLayout.itsFilters.push_back(f);
+	}
+
+	H5Pclose(dcpl);
+
+	if(status != NC_NOERR)
+		return status;
+
+	theLayout.itsChunk.assign(chunk.begin(), chunk.end());
+	theLayout.itsChunkBytes = Volume(theLayout.itsChunk) * theLayout.itsElementSize;
+
+	return NC_NOERR;
+}
+
+int dataset::Open(int theRootId, int theNcId, int theVarId, bool theWrite, layout& theLayout)
+{
+	std::string path, varPath;
+	if(Paths(theRootId, theNcId, theVarId, path, varPath) != NC_NOERR || path.empty())
+		return NC_EINVAL;
+
+	itsFile = H5Fopen(path.c_str(), theWrite ? H5F_ACC_RDWR : H5F_ACC_RDONLY, H5P_DEFAULT);
+	if(itsFile < 0)
+		return NC_EINVAL;
+
+	// datasets of new variables are created in the file only when define mode ends, which is left to the caller
+	itsDataset = H5Dopen(itsFile, varPath.c_str(), H5P_DEFAULT);
+	if(itsDataset < 0)
+		return NC_EINDEFINE;
+
+	return Describe(itsDataset, theLayout);
+}
+
+void dataset::Close()
+{
+	if(itsDataset >= 0)
+		H5Dclose(itsDataset);
+	if(itsFile >= 0)
+		H5Fclose(itsFile);
+
+	itsDataset = -1;
+	itsFile = -1;
+}
+
+// Origin of chunk i of the chunk grid, chunks in storage (row-major) order
+static std::vector<size_t> ChunkOrigin(const layout& theLayout, size_t i)
+{
+	const size_t n = theLayout.itsShape.size();
+	std::vector<size_t> ret(n);
+
+	for(size_t d = n; d-- > 0;)
+	{
+		const size_t chunks = (theLayout.itsShape[d] + theLayout.itsChunk[d] - 1) / theLayout.itsChunk[d];
+		ret[d] = (i % chunks) * theLayout.itsChunk[d];
+		i /= chunks;
+	}
+
+	return ret;
+}
+
+static size_t Chunks(const layout& theLayout)
+{
+	size_t ret = 1;
+	for(size_t d = 0; d < theLayout.itsShape.size(); ++d)
+		ret *= (theLayout.itsShape[d] + theLayout.itsChunk[d] - 1) / theLayout.itsChunk[d];
+
+	return ret;
+}
+
+// Part of the chunk at given origin that lies inside the variable
+static std::vector<size_t> ChunkCount(const layout& theLayout, const std::vector<size_t>& theOrigin)
+{
+	std::vector<size_t> ret(theOrigin.size());
+	for(size_t d = 0; d < theOrigin.size(); ++d)
+		ret[d] = std::min(theLayout.itsChunk[d], theLayout.itsShape[d] - theOrigin[d]);
+
+	return ret;
+}
+
+// Byte shuffle as done by the HDF5 shuffle filter: byte b of every element is stored together, trailing bytes as they are
+static void Shuffle(std::vector<unsigned char>& theData, size_t theElementSize, bool theForward)
+{
+	const size_t elements = theData.size() / theElementSize;
+	if(theElementSize < 2 || elements < 2)
+		return;
+
+	std::vector<unsigned char> out(theData.size());
+
+	for(size_t e = 0; e < elements; ++e)
+	{
+		for(size_t b = 0; b < theElementSize; ++b)
+		{
+			if(theForward)
+				out[b * elements + e] = theData[e * theElementSize + b];
+			else
+				out[e * theElementSize + b] = theData[b * elements + e];
+		}
+	}
+
+	std::copy(theData.begin() + elements * theElementSize, theData.end(), out.begin() + elements * theElementSize);
+	theData.swap(out);
+}
+
+// Undo filters not marked skipped in the filter mask of the chunk and place its data in the variable
+static void Decode(const layout& theLayout, std::vector<unsigned char>& theRaw, unsigned int theMask, const std::vector<size_t>& theOrigin, void* theData)
+{
+	for(size_t i = theLayout.itsFilters.size(); i-- > 0;)
+	{
+		if(theMask & (1u << i))
+			continue;
+
+		if(theLayout.itsFilters[i].itsId == H5Z_FILTER_SHUFFLE)
+		{
+			Shuffle(theRaw, theLayout.itsElementSize, false);
+			continue;
+		}
+
+		std::vector<unsigned char> out(theLayout.itsChunkBytes);
+		uLongf len = static_cast<uLongf>(out.size());
+
+		if(uncompress(out.data(), &len, theRaw.data(), static_cast<uLong>(theRaw.size())) != Z_OK)
+			throw nc_error(NC_EHDFERR);
+
+		out.resize(len);
+		theRaw.swap(out);
+	}
+
+	if(theRaw.size() != theLayout.itsChunkBytes)
+		throw nc_error(NC_EHDFERR);
+
+	CopyHyperslab(theRaw.data(), theOrigin, theLayout.itsChunk, theData, std::vector<size_t>(theOrigin.size(), 0), theLayout.itsShape,
+			theOrigin, ChunkCount(theLayout, theOrigin), theLayout.itsElementSize);
+}
+
+// Take the chunk at given origin from the variable and apply filters. Part of an edge chunk outside the variable is zero.
+static void Encode(const layout& theLayout, const void* theData, const std::vector<size_t>& theOrigin, std::vector<unsigned char>& theRaw)
+{
+	theRaw.assign(theLayout.itsChunkBytes, 0);
+
+	CopyHyperslab(theData, std::vector<size_t>(theOrigin.size(), 0), theLayout.itsShape, theRaw.data(), theOrigin, theLayout.itsChunk,
+			theOrigin, ChunkCount(theLayout, theOrigin), theLayout.itsElementSize);
+
+	for(const filter& f : theLayout.itsFilters)
+	{
+		if(f.itsId == H5Z_FILTER_SHUFFLE)
+		{
+			Shuffle(theRaw, theLayout.itsElementSize, true);
+			continue;
+		}
+
+		std::vector<unsigned char> out(compressBound(static_cast<uLong>(theRaw.size())));
+		uLongf len = static_cast<uLongf>(out.size());
+
+		if(compress2(out.data(), &len, theRaw.data(), static_cast<uLong>(theRaw.size()), f.itsLevel) != Z_OK)
+			throw nc_error(NC_EHDFERR);
+
+		out.resize(len);
+		theRaw.swap(out);
+	}
+}
+
+// Run task in the pool, or right away on threads of a pool as tasks there must not wait for each other
+static std::future<void> Submit(nc_thread_pool* thePool, std::function<void()> theTask)
+{
+	if(thePool)
+		return thePool->Submit(theTask);
+
+	std::packaged_task<void()> task(theTask);
+	std::future<void> ret = task.get_future();
+	task();
+
+	return ret;
+}
+
+// Wait for every task not waited for yet before returning, tasks refer to buffers of the caller. First error wins.
+static int Wait(std::vector<std::future<void>>& theResults, int theStatus)
+{
+	for(auto& r : theResults)
+	{
+		if(r.valid())
+			r.wait();
+	}
+
+	for(auto& r : theResults)
+	{
+		if(!r.valid())
+			continue;
+
+		try
+		{
+			r.get();
+		}
+		catch(const nc_error& e)
+		{
+			if(theStatus == NC_NOERR)
+				theStatus = e.Status();
+		}
+		catch(...)
+		{
+			if(theStatus == NC_NOERR)
+				theStatus = NC_EHDFERR;
+		}
+	}
+
+	return theStatus;
+}
+
+/*
+ * Raw chunks are read in storage order with the lock held and each is handed to the pool as soon as it is read,
+ * so decoding overlaps reading. Chunks never written hold fill values and are read through the library.
+ */
+
+/*
+ * Files created or opened from memory have only a cache key for a path, and a disk file of that name would be an
+ * unrelated one. Mapped files are not opened a second time behind the library.
+ */
+
+static bool OnDisk(const nc_file& theFile)
+{
+	return !theFile.itsOptions.itsInMemory && !theFile.itsMapping;
+}
+
+int ReadChunks(nc_file& theFile, int theNcId, int theVarId, const std::vector<size_t>& theShape, size_t theElementSize, void* theData)
+{
+	if(!OnDisk(theFile))
+		return NC_EINVAL;
+
+	auto l = std::make_shared<layout>();
+	l->itsShape = theShape;
+	l->itsElementSize = theElementSize;
+
+	if(Volume(theShape) == 0)
+		return NC_EINVAL;
+
+	std::shared_ptr<nc_thread_pool> pool = nc_thread_pool::InWorker() ? nullptr : ThreadPool();
+	std::vector<std::future<void>> results;
+	int status;
+
+	{
+		auto lock = theFile.Lock();
+
+		dataset ds;
+		status = ds.Open(theFile.itsNcId, theNcId, theVarId, false, *l);
+		if(status != NC_NOERR)
+		{
+			ds.Close();
+			return status;
+		}
+
+		const size_t chunks = Chunks(*l);
+		results.reserve(chunks);
+
+		try
+		{
+			for(size_t i = 0; i < chunks; ++i)
+			{
+				const std::vector<size_t> origin = ChunkOrigin(*l, i);
+				const std::vector<hsize_t> offset(origin.begin(), origin.end());
+
+				hsize_t bytes = 0;
+				if(H5Dget_chunk_storage_size(ds.Id(), offset.data(), &bytes) < 0 || bytes == 0)
+				{
+					const std::vector<size_t> count = ChunkCount(*l, origin);
+					std::vector<unsigned char> buffer(Volume(count) * theElementSize);
+
+					status = nc_get_vara(theNcId, theVarId, origin.data(), count.data(), buffer.data());
+					if(status != NC_NOERR)
+						break;
+
+					CopyHyperslab(buffer.data(), origin, count, theData, std::vector<size_t>(origin.size(), 0), theShape, origin, count, theElementSize);
+					continue;
+				}
+
+				auto raw = std::make_shared<std::vector<unsigned char>>(bytes);
+				uint32_t mask = 0;
+
+				if(H5Dread_chunk(ds.Id(), H5P_DEFAULT, offset.data(), &mask, raw->data()) < 0)
+				{
+					status = NC_EHDFERR;
+					break;
+				}
+
+				results.push_back(Submit(pool.get(), [l, raw, mask, origin, theData]()
+				{
+					Decode(*l, *raw, mask, origin, theData);
+				}));
+			}
+		}
+		catch(...)
+		{
+			status = NC_ENOMEM;
+		}
+
+		ds.Close();
+	}
+
+	return Wait(results, status);
+}
+
+/*
+ * Chunks are encoded in the pool and written in storage order as they become ready, the lock is taken for each write.
+ */
+
+int WriteChunks(nc_file& theFile, int theNcId, int theVarId, const std::vector<size_t>& theShape, size_t theElementSize, const void* theData)
+{
+	if(!OnDisk(theFile))
+		return NC_EINVAL;
+
+	auto l = std::make_shared<layout>();
+	l->itsShape = theShape;
+	l->itsElementSize = theElementSize;
+
+	if(Volume(theShape) == 0)
+		return NC_EINVAL;
+
+	dataset ds;
+	int status;
+	{
+		auto lock = theFile.Lock();
+
+		status = ds.Open(theFile.itsNcId, theNcId, theVarId, true, *l);
+		if(status != NC_NOERR)
+		{
+			ds.Close();
+			return status;
+		}
+	}
+
+	std::shared_ptr<nc_thread_pool> pool = nc_thread_pool::InWorker() ? nullptr : ThreadPool();
+
+	const size_t chunks = Chunks(*l);
+	std::vector<std::vector<unsigned char>> encoded(chunks);
+	std::vector<std::future<void>> results;
+	results.reserve(chunks);
+
+	try
+	{
+		for(size_t i = 0; i < chunks; ++i)
+		{
+			std::vector<unsigned char>* raw = &encoded[i];
+
+			results.push_back(Submit(pool.get(), [l, theData, i, raw]()
+			{
+				Encode(*l, theData, ChunkOrigin(*l, i), *raw);
+			}));
+		}
+
+		for(size_t i = 0; i < results.size() && status == NC_NOERR; ++i)
+		{
+			std::future<void> result = std::move(results[i]);
+			result.get();
+
+			const std::vector<size_t> origin = ChunkOrigin(*l, i);
+			const std::vector<hsize_t> offset(origin.begin(), origin.end());
+
+			auto lock = theFile.Lock();
+
+			if(H5Dwrite_chunk(ds.Id(), H5P_DEFAULT, 0, offset.data(), encoded[i].size(), encoded[i].data()) < 0)
+				status = NC_EHDFERR;
+
+			std::vector<unsigned char>().swap(encoded[i]);
+		}
+	}
+	catch(const nc_error& e)
+	{
+		status = e.Status();
+	}
+	catch(...)
+	{
+		status = NC_ENOMEM;
+	}
+
+	status = Wait(results, status);
+
+	auto lock = theFile.Lock();
+	ds.Close();
+
+	return status;
+}
+
+#else
+
+int ReadChunks(nc_file&, int, int, const std::vector<size_t>&, size_t, void*)
+{
+	return NC_ENOTBUILT;
+}
+
+int WriteChunks(nc_file&, int, int, const std::vector<size_t>&, size_t, const void*)
+{
+	return NC_ENOTBUILT;
+}
+
+#endif
+
+} // end namespace
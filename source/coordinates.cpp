@@ -0,0 +1,190 @@
+#include "coordinates.h"
+#include <algorithm>
+#include <cmath>
+
+namespace fminc4
+{
+
+nc_coordinate::nc_coordinate(std::vector<double>&& theValues) : itsValues(std::move(theValues)), itsOrder(0), itsRegular(false), itsStep(0)
+{
+	const std::vector<double>& v = itsValues;
+
+	bool increasing = true;
+	bool decreasing = true;
+	for(size_t i = 1; i < v.size() && (increasing || decreasing); ++i)
+	{
+		// NaN compares false both ways and makes the values unordered
+		increasing = increasing && v[i] >= v[i - 1];
+		decreasing = decreasing && v[i] <= v[i - 1];
+	}
+
+	if(increasing && !std::any_of(v.begin(), v.end(), [](double x) { return std::isnan(x); }))
+		itsOrder = 1;
+	else if(decreasing && !std::any_of(v.begin(), v.end(), [](double x) { return std::isnan(x); }))
+		itsOrder = -1;
+
+	if(itsOrder == 0 || v.size() < 2)
+		return;
+
+	itsStep = (v.back() - v.front()) / static_cast<double>(v.size() - 1);
+	if(itsStep == 0)
+		return;
+
+	// values stored as float are evenly spaced only within rounding, index guesses are corrected in Partition
+	const double tolerance = 1e-3 * std::fabs(itsStep);
+
+	itsRegular = true;
+	for(size_t i = 1; i < v.size() && itsRegular; ++i)
+		itsRegular = std::fabs(v[i] - v[i - 1] - itsStep) <= tolerance;
+}
+
+/*
+ * Number of leading values for which thePred holds, the predicate holding for a prefix of the values. Evenly spaced
+ * values give the index of theThreshold directly and it is moved by a step or two to the exact place. Rounding errors
+ * within the tolerance add up over long coordinates, a guess further off than that is replaced by bisection.
+ */
+
+const size_t kMaxCorrection = 2;
+
+template<typename PRED>
+static size_t Partition(const nc_coordinate& theCoordinate, double theThreshold, PRED thePred)
+{
+	const std::vector<double>& v = theCoordinate.itsValues;
+
+	if(!theCoordinate.itsRegular)
+		return static_cast<size_t>(std::partition_point(v.begin(), v.end(), thePred) - v.begin());
+
+	const double guess = std::ceil((theThreshold - v.front()) / theCoordinate.itsStep);
+
+	size_t ret = 0;
+	if(guess >= static_cast<double>(v.size()))
+		ret = v.size();
+	else if(guess > 0)
+		ret = static_cast<size_t>(guess);
+
+	for(size_t i = 0; i < kMaxCorrection && ret > 0 && !thePred(v[ret - 1]); ++i)
+		--ret;
+	for(size_t i = 0; i < kMaxCorrection && ret < v.size() && thePred(v[ret]); ++i)
+		++ret;
+
+	if((ret > 0 && !thePred(v[ret - 1])) || (ret < v.size() && thePred(v[ret])))
+		return static_cast<size_t>(std::partition_point(v.begin(), v.end(), thePred) - v.begin());
+
+	return ret;
+}
+
+int nc_coordinate::Range(double theMin, double theMax, size_t& theStart, size_t& theCount) const
+{
+	if(itsOrder == 0)
+		return NC_EINVAL;
+
+	size_t end;
+	if(itsOrder > 0)
+	{
+		theStart = Partition(*this, theMin, [=](double x) { return x < theMin; });
+		end = Partition(*this, theMax, [=](double x) { return x <= theMax; });
+	}
+	else
+	{
+		theStart = Partition(*this, theMax, [=](double x) { return x > theMax; });
+		end = Partition(*this, theMin, [=](double x) { return x >= theMin; });
+	}
+
+	theCount = end > theStart ? end - theStart : 0;
+	return NC_NOERR;
+}
+
+int nc_coordinate::Nearest(double theValue, size_t& theIndex) const
+{
+	if(itsOrder == 0 || itsValues.empty() || std::isnan(theValue))
+		return NC_EINVAL;
+
+	// first value at or past theValue in the order of the values
+	size_t i;
+	if(itsOrder > 0)
+		i = Partition(*this, theValue, [=](double x) { return x < theValue; });
+	else
+		i = Partition(*this, theValue, [=](double x) { return x > theValue; });
+
+	if(i == itsValues.size())
+		theIndex = i - 1;
+	else if(i > 0 && std::fabs(itsValues[i - 1] - theValue) <= std::fabs(itsValues[i] - theValue))
+		theIndex = i - 1;
+	else
+		theIndex = i;
+
+	return NC_NOERR;
+}
+
+nc_selection& nc_selection::Range(const std::string& theDim, double theMin, double theMax)
+{
+	item i;
+	i.itsDim = theDim;
+	i.itsKind = kRange;
+	i.itsMin = theMin;
+	i.itsMax = theMax;
+	i.itsStart = 0;
+	i.itsCount = 0;
+
+	itsItems.push_back(i);
+	return *this;
+}
+
+nc_selection& nc_selection::Nearest(const std::string& theDim, double theValue)
+{
+	item i;
+	i.itsDim = theDim;
+	i.itsKind = kNearest;
+	i.itsMin = theValue;
+	i.itsMax = theValue;
+	i.itsStart = 0;
+	i.itsCount = 1;
+
+	itsItems.push_back(i);
+	return *this;
+}
+
+nc_selection& nc_selection::Index(const std::string& theDim, size_t theStart, size_t theCount)
+{
+	item i;
+	i.itsDim = theDim;
+	i.itsKind = kIndex;
+	i.itsMin = 0;
+	i.itsMax = 0;
+	i.itsStart = theStart;
+	i.itsCount = theCount;
+
+	itsItems.push_back(i);
+	return *this;
+}
+
+std::shared_ptr<const nc_coordinate> nc_coord_cache::Find(int theNcId, int theVarId) const
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	auto it = itsCoordinates.find(key(theNcId, theVarId));
+	return it == itsCoordinates.end() ? nullptr : it->second;
+}
+
+void nc_coord_cache::Insert(int theNcId, int theVarId, std::shared_ptr<const nc_coordinate> theCoordinate)
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	itsCoordinates[key(theNcId, theVarId)] = theCoordinate;
+}
+
+void nc_coord_cache::Erase(int theNcId, int theVarId)
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	itsCoordinates.erase(key(theNcId, theVarId));
+}
+
+void nc_coord_cache::Clear()
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	itsCoordinates.clear();
+}
+
+} // end namespace fminc4
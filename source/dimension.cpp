@@ -1,33 +1,66 @@
 #include "dimension.h"
 #include "group.h"
+#include "metadata.h"
 
 namespace fminc4
 {
 
-extern std::mutex netcdfLibMutex;
+nc_dim::nc_dim(std::shared_ptr<nc_file> theFile, int theNcId, int theDimId) : itsFile(theFile), itsNcId(theNcId), itsDimId(theDimId)
+{
+	auto metadata = itsFile->Metadata();
+
+	const nc_dim_info* dim = metadata->Dim(itsDimId);
+	if(!dim)
+		throw nc_error(NC_EBADDIM);
+
+	itsLength = dim->itsUnlimited ? 0 : dim->itsLength;
+}
 
-nc_dim::nc_dim(int theNcId, int theDimId) : itsNcId(theNcId), itsDimId(theDimId) {}
+nc_dim::nc_dim(std::shared_ptr<nc_file> theFile, int theNcId, int theDimId, size_t theLength) : itsFile(theFile), itsNcId(theNcId), itsDimId(theDimId), itsLength(theLength) {}
 
 std::string nc_dim::Name()
 {
-        char recname[NC_MAX_NAME+1];
-        nc_inq_dimname(itsNcId, itsDimId, recname);
-        return std::string(recname);
+	auto metadata = itsFile->Metadata();
+
+	const nc_dim_info* dim = metadata->Dim(itsDimId);
+	if(!dim)
+		throw nc_error(NC_EBADDIM);
+
+        return dim->itsName;
 }
 
 void nc_dim::Name(const std::string& theName)
 {
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
-        nc_rename_dim(itsNcId, itsDimId, theName.c_str());
+	auto lock = itsFile->Lock();
+
+        int status = nc_rename_dim(itsNcId, itsDimId, theName.c_str());
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	itsFile->Invalidate();
 }
 
 size_t nc_dim::Size()
 {
+	if(itsLength > 0)
+		return itsLength;
+
+	// unlimited dimensions grow with every write
+	auto lock = itsFile->Lock();
+
         size_t dimSize;
-        nc_inq_dimlen(itsNcId, itsDimId, &dimSize);
+        int status = nc_inq_dimlen(itsNcId, itsDimId, &dimSize);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
 	return dimSize;
 }
 
+bool nc_dim::Unlimited() const
+{
+	return itsLength == 0;
+}
+
 int nc_dim::NcId()
 {
 	return itsNcId;
@@ -0,0 +1,342 @@
+#include "filecache.h"
+#include "fminc4.h"
+
+namespace fminc4
+{
+
+nc_file_cache::nc_file_cache() : itsMaxFiles(0), itsMaxIdle(0), itsSerial(0), itsHits(0), itsMisses(0), itsEvictions(0), itsOpenFiles(0)
+{
+}
+
+nc_file_cache::shard& nc_file_cache::Shard(const std::string& theKey)
+{
+	return itsShards[std::hash<std::string>()(theKey) % kShards];
+}
+
+// File is only held by the cache once opened. Opens in progress count as referenced.
+static bool Unreferenced(const std::shared_future<std::shared_ptr<nc_file>>& theFile)
+{
+	if(theFile.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	try
+	{
+		return theFile.get().use_count() == 1;
+	}
+	catch(...)
+	{
+		return false; // failed open, removed by the opener
+	}
+}
+
+// Idle files of a shard, least recently used first. Entries in use are skipped.
+void nc_file_cache::Evict(shard& theShard, std::chrono::steady_clock::time_point theNow, std::vector<file_future>& theEvicted)
+{
+	const std::chrono::seconds maxIdle(itsMaxIdle.load());
+
+	if(maxIdle.count() == 0)
+		return;
+
+	for(auto it = theShard.itsUse.end(); it != theShard.itsUse.begin();)
+	{
+		--it;
+
+		auto e = theShard.itsEntries.find(*it);
+
+		// rest of the entries are used more recently
+		if(theNow - e->second.itsLastUse <= maxIdle)
+			break;
+
+		if(!Unreferenced(e->second.itsFile))
+			continue;
+
+		theEvicted.push_back(e->second.itsFile);
+		theShard.itsEntries.erase(e);
+		it = theShard.itsUse.erase(it);
+
+		++itsEvictions;
+		--itsOpenFiles;
+	}
+}
+
+/*
+ * Size limit holds for the whole cache: the least recently used unreferenced file of any shard goes first. All shards
+ * are locked, in order, which is only done while the cache is over the limit.
+ */
+
+void nc_file_cache::EvictOver(std::vector<file_future>& theEvicted)
+{
+	const size_t maxFiles = itsMaxFiles.load();
+
+	if(maxFiles == 0 || itsOpenFiles.load() <= maxFiles)
+		return;
+
+	std::unique_lock<std::mutex> locks[kShards];
+	for(size_t i = 0; i < kShards; ++i)
+		locks[i] = std::unique_lock<std::mutex>(itsShards[i].itsMutex);
+
+	while(itsOpenFiles.load() > maxFiles)
+	{
+		shard* oldest = nullptr;
+		std::unordered_map<std::string, entry>::iterator victim;
+
+		for(shard& s : itsShards)
+		{
+			// least recently used unreferenced entry of the shard
+			for(auto it = s.itsUse.end(); it != s.itsUse.begin();)
+			{
+				--it;
+
+				auto e = s.itsEntries.find(*it);
+				if(!Unreferenced(e->second.itsFile))
+					continue;
+
+				if(!oldest || e->second.itsLastUse < victim->second.itsLastUse)
+				{
+					oldest = &s;
+					victim = e;
+				}
+				break;
+			}
+		}
+
+		// rest of the files are in use
+		if(!oldest)
+			break;
+
+		theEvicted.push_back(victim->second.itsFile);
+		oldest->itsUse.erase(victim->second.itsUse);
+		oldest->itsEntries.erase(victim);
+
+		++itsEvictions;
+		--itsOpenFiles;
+	}
+}
+
+std::shared_ptr<nc_file> nc_file_cache::Get(const std::string& theKey, const std::function<std::shared_ptr<nc_file>()>& theOpen)
+{
+	const auto now = std::chrono::steady_clock::now();
+	shard& s = Shard(theKey);
+
+	std::vector<file_future> evicted;
+	std::promise<std::shared_ptr<nc_file>> promise;
+	file_future file;
+	std::shared_ptr<nc_file> ret;
+	size_t serial = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(s.itsMutex);
+
+		auto it = s.itsEntries.find(theKey);
+		if(it != s.itsEntries.end())
+		{
+			++itsHits;
+			s.itsUse.splice(s.itsUse.begin(), s.itsUse, it->second.itsUse);
+			it->second.itsLastUse = now;
+			file = it->second.itsFile;
+
+			// referenced before the lock is released, so that neither Erase nor eviction closes it meanwhile
+			if(file.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				try
+				{
+					ret = file.get();
+				}
+				catch(...)
+				{
+				}
+			}
+
+			Evict(s, now, evicted);
+		}
+		else
+		{
+			++itsMisses;
+			++itsOpenFiles;
+			serial = ++itsSerial;
+
+			s.itsUse.push_front(theKey);
+
+			entry e;
+			e.itsFile = promise.get_future().share();
+			e.itsSerial = serial;
+			e.itsLastUse = now;
+			e.itsUse = s.itsUse.begin();
+			s.itsEntries.insert(std::make_pair(theKey, e));
+
+			file = e.itsFile;
+		}
+	}
+
+	if(serial == 0)
+	{
+		// files released since the last open may leave the cache over the limit
+		EvictOver(evicted);
+
+		// files are closed outside the locks
+		evicted.clear();
+		return ret ? ret : file.get();
+	}
+
+	evicted.clear();
+
+	try
+	{
+		ret = theOpen();
+		promise.set_value(ret);
+	}
+	catch(...)
+	{
+		promise.set_exception(std::current_exception());
+
+		std::lock_guard<std::mutex> lock(s.itsMutex);
+
+		// entry may have been removed and created again meanwhile
+		auto it = s.itsEntries.find(theKey);
+		if(it != s.itsEntries.end() && it->second.itsSerial == serial)
+		{
+			s.itsUse.erase(it->second.itsUse);
+			s.itsEntries.erase(it);
+			--itsOpenFiles;
+		}
+
+		throw;
+	}
+
+	// opens are rare compared to lookups, look for idle files in every shard
+	for(shard& other : itsShards)
+	{
+		std::lock_guard<std::mutex> lock(other.itsMutex);
+		Evict(other, now, evicted);
+	}
+
+	EvictOver(evicted);
+	evicted.clear();
+
+	return ret;
+}
+
+/*
+ * The reference is taken under the lock of the shard, so that Erase sees it and cannot close the file in between.
+ * Opens in progress are waited for outside the lock and the entry looked up again.
+ */
+
+std::shared_ptr<nc_file> nc_file_cache::Find(const std::string& theKey)
+{
+	shard& s = Shard(theKey);
+
+	while(true)
+	{
+		file_future file;
+
+		{
+			std::lock_guard<std::mutex> lock(s.itsMutex);
+
+			auto it = s.itsEntries.find(theKey);
+			if(it == s.itsEntries.end())
+				return nullptr;
+
+			file = it->second.itsFile;
+
+			if(file.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				try
+				{
+					return file.get();
+				}
+				catch(...)
+				{
+					return nullptr;
+				}
+			}
+		}
+
+		file.wait();
+	}
+}
+
+bool nc_file_cache::Erase(const std::string& theKey, long theReferences)
+{
+	shard& s = Shard(theKey);
+	file_future file;
+
+	{
+		std::lock_guard<std::mutex> lock(s.itsMutex);
+
+		auto it = s.itsEntries.find(theKey);
+		if(it == s.itsEntries.end() || it->second.itsFile.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+
+		try
+		{
+			if(it->second.itsFile.get().use_count() > 1 + theReferences)
+				return false;
+		}
+		catch(...)
+		{
+			return false;
+		}
+
+		file = it->second.itsFile;
+		s.itsUse.erase(it->second.itsUse);
+		s.itsEntries.erase(it);
+		--itsOpenFiles;
+	}
+
+	return true;
+}
+
+void nc_file_cache::Clear()
+{
+	std::vector<file_future> files;
+
+	for(shard& s : itsShards)
+	{
+		{
+			std::lock_guard<std::mutex> lock(s.itsMutex);
+
+			for(auto& e : s.itsEntries)
+				files.push_back(e.second.itsFile);
+
+			itsOpenFiles -= s.itsEntries.size();
+			s.itsEntries.clear();
+			s.itsUse.clear();
+		}
+
+		files.clear();
+	}
+}
+
+void nc_file_cache::Limits(size_t theMaxFiles, std::chrono::seconds theMaxIdle)
+{
+	itsMaxFiles.store(theMaxFiles);
+	itsMaxIdle.store(theMaxIdle.count());
+
+	const auto now = std::chrono::steady_clock::now();
+	std::vector<file_future> evicted;
+
+	for(shard& s : itsShards)
+	{
+		{
+			std::lock_guard<std::mutex> lock(s.itsMutex);
+			Evict(s, now, evicted);
+		}
+
+		evicted.clear();
+	}
+
+	EvictOver(evicted);
+}
+
+nc_file_cache_stats nc_file_cache::Stats() const
+{
+	nc_file_cache_stats ret;
+	ret.itsHits = itsHits.load();
+	ret.itsMisses = itsMisses.load();
+	ret.itsEvictions = itsEvictions.load();
+	ret.itsOpenFiles = itsOpenFiles.load();
+
+	return ret;
+}
+
+} // end namespace
@@ -1,14 +1,418 @@
 #include "fminc4.h"
-#include <map>
+#include "blockcache.h"
+#include "attributes.h"
+#include "mapping.h"
+#include "catalogue.h"
+#include "coordinates.h"
+#include <netcdf_mem.h>
+#include <netcdf_meta.h>
+#ifdef FMINC4_HAVE_MPI
+#include <netcdf_par.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
 #include <memory>
+#include <cstdlib>
+#include <vector>
+#include <sys/stat.h>
 #include "group.h"
+#include "metadata.h"
+#include "writequeue.h"
+#include "stats.h"
 
 namespace fminc4
 {
 
 // definitions
 std::mutex netcdfLibMutex;
-std::map<std::string, std::shared_ptr<nc_file>> fileCache;
+nc_file_cache fileCache;
+std::atomic<NcLockMode> lockMode(kNcLockGlobal);
+
+// Calls touching library wide state are serialized globally unless the library is declared thread-safe
+std::unique_lock<std::mutex> LibraryLock(NcLockMode theMode)
+{
+	FMINC4_STATS_LOCK_WAIT();
+
+	if(theMode == kNcLockNone)
+		return std::unique_lock<std::mutex>();
+
+	return std::unique_lock<std::mutex>(netcdfLibMutex);
+}
+
+/*
+ * Open a mapped file. Library is told that the memory is not its own (locked) so that it neither frees nor extends it.
+ */
+
+static int OpenMapped(const std::string& thePath, nc_mapping& theMapping, int* theNcId)
+{
+	NC_memio memio;
+	memio.size = theMapping.Size();
+	memio.memory = const_cast<void*>(theMapping.Data());
+	memio.flags = NC_MEMIO_LOCKED;
+
+	return nc_open_memio(thePath.c_str(), kNcReadOnly, &memio, theNcId);
+}
+
+/*
+ * Scan the layout of a newly opened file and apply chunk cache and parallel access settings to every variable
+ */
+
+static void ConfigureChunkCaches(nc_file& theFile)
+{
+	auto metadata = theFile.Metadata();
+
+	auto lock = theFile.Lock();
+
+	for(const auto& group : metadata->Groups())
+	{
+		for(size_t varId = 0; varId < group.second.itsVars.size(); ++varId)
+		{
+			int status = theFile.ConfigureChunkCache(group.first, static_cast<int>(varId));
+			if(status == NC_NOERR)
+				status = theFile.ConfigureParAccess(group.first, static_cast<int>(varId));
+			if(status != NC_NOERR)
+				throw nc_error(status);
+		}
+	}
+}
+
+nc_file::nc_file(int theNcId, NcLockMode theLockMode, const nc_open_options& theOptions, std::shared_ptr<nc_mapping> theMapping, const std::string& thePath, bool theParallel)
+	: itsNcId(theNcId), itsLockMode(theLockMode), itsOptions(theOptions), itsMapping(theMapping), itsPath(thePath), itsParallel(theParallel), itsAttCache(new nc_att_cache), itsCoordCache(new nc_coord_cache), itsWrites(0), itsSiblingWrites(0), itsClosed(false)
+{
+	if(itsOptions.itsBlockCacheSize > 0)
+		itsBlockCache.reset(new nc_block_cache(*this, itsOptions.itsBlockCacheSize));
+}
+
+nc_file::~nc_file()
+{
+	// pending asynchronous writes are written before closing
+	itsWriteQueue.reset();
+
+	if(itsClosed)
+		return;
+
+	auto lock = LibraryLock(itsLockMode);
+	nc_close(itsNcId);
+}
+
+std::unique_lock<std::mutex> nc_file::Lock()
+{
+	// waiting is charged to the call measured on this thread
+	FMINC4_STATS_LOCK_WAIT();
+
+	return Acquire();
+}
+
+std::unique_lock<std::mutex> nc_file::Acquire()
+{
+	switch(itsLockMode)
+	{
+		case kNcLockGlobal:
+			return std::unique_lock<std::mutex>(netcdfLibMutex);
+		case kNcLockFile:
+			return std::unique_lock<std::mutex>(itsMutex);
+		default:
+			return std::unique_lock<std::mutex>();
+	}
+}
+
+nc_write_queue& nc_file::WriteQueue()
+{
+	std::lock_guard<std::mutex> lock(itsWriteQueueMutex);
+
+	if(!itsWriteQueue)
+		itsWriteQueue.reset(new nc_write_queue(*this));
+
+	return *itsWriteQueue;
+}
+
+void nc_file::Flush()
+{
+	nc_write_queue* queue;
+	{
+		std::lock_guard<std::mutex> lock(itsWriteQueueMutex);
+		queue = itsWriteQueue.get();
+	}
+
+	// queue lives as long as the file, drain without blocking new submissions
+	if(queue)
+		queue->Drain();
+}
+
+nc_result<std::shared_ptr<const nc_metadata>> nc_file::TryMetadata()
+{
+	std::shared_ptr<const nc_metadata> ret = std::atomic_load(&itsMetadata);
+	if(ret)
+		return ret;
+
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsPath, nullptr);
+
+	auto lock = Lock();
+
+	// file structure cannot change while the lock is held
+	try
+	{
+		ret = nc_metadata::Scan(itsNcId);
+	}
+	catch(const nc_error& e)
+	{
+		FMINC4_STATS_ERROR(e.Status());
+		return nc_failure(e.Status());
+	}
+
+	std::atomic_store(&itsMetadata, ret);
+
+	return ret;
+}
+
+std::shared_ptr<const nc_metadata> nc_file::Metadata()
+{
+	return TryMetadata().Value();
+}
+
+const nc_var_info* nc_file::Layout(int theNcId, int theVarId, const nc_var_info& theInfo)
+{
+	std::lock_guard<std::mutex> lock(itsLayoutMutex);
+
+	std::unique_ptr<const nc_var_info>& ret = itsLayouts[std::make_pair(theNcId, theVarId)];
+	if(!ret)
+	{
+		std::unique_ptr<nc_var_info> layout(new nc_var_info(theInfo));
+		layout->itsAtts.clear();
+		ret = std::move(layout);
+	}
+
+	return ret.get();
+}
+
+void nc_file::Invalidate()
+{
+	Modified();
+
+	std::atomic_store(&itsMetadata, std::shared_ptr<const nc_metadata>());
+	itsAttCache->Clear();
+	itsCoordCache->Clear();
+
+	if(itsBlockCache)
+		itsBlockCache->Clear();
+}
+
+int nc_file::ConfigureChunkCache(int theNcId, int theVarId)
+{
+	if(itsOptions.itsChunkCacheSize == 0 && itsOptions.itsChunkCacheSlots == 0 && itsOptions.itsChunkCachePreemption < 0)
+		return NC_NOERR;
+
+	size_t size, slots;
+	float preemption;
+
+	int status = nc_get_var_chunk_cache(theNcId, theVarId, &size, &slots, &preemption);
+
+	// classic format files have no chunk cache
+	if(status == NC_ENOTNC4)
+		return NC_NOERR;
+	if(status != NC_NOERR)
+		return status;
+
+	if(itsOptions.itsChunkCacheSize > 0)
+		size = itsOptions.itsChunkCacheSize;
+	if(itsOptions.itsChunkCacheSlots > 0)
+		slots = itsOptions.itsChunkCacheSlots;
+	if(itsOptions.itsChunkCachePreemption >= 0)
+		preemption = itsOptions.itsChunkCachePreemption;
+
+	return nc_set_var_chunk_cache(theNcId, theVarId, size, slots, preemption);
+}
+
+int nc_file::ConfigureParAccess(int theNcId, int theVarId)
+{
+	if(!itsParallel)
+		return NC_NOERR;
+
+	return nc_var_par_access(theNcId, theVarId, itsOptions.itsParAccess);
+}
+
+nc_block_cache* nc_file::BlockCache()
+{
+	return itsBlockCache.get();
+}
+
+nc_att_cache& nc_file::AttCache()
+{
+	return *itsAttCache;
+}
+
+nc_coord_cache& nc_file::CoordCache()
+{
+	return *itsCoordCache;
+}
+
+std::shared_ptr<nc_file> nc_file::Reopen()
+{
+	if(itsOptions.itsInMemory)
+		throw nc_error(NC_EINMEMORY);
+
+	// a serial handle would bypass MPI-IO of the other ranks
+	if(itsParallel)
+		throw nc_error(NC_EINVAL);
+
+	// data written through this handle must be visible to the new one
+	Flush();
+
+	std::string path;
+	{
+		auto lock = Lock();
+
+		int status = nc_sync(itsNcId);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		size_t len;
+		status = nc_inq_path(itsNcId, &len, NULL);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		std::vector<char> buffer(len + 1);
+		status = nc_inq_path(itsNcId, &len, buffer.data());
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		path.assign(buffer.data(), len);
+	}
+
+	int ncId;
+	int status;
+	{
+		auto liblock = LibraryLock(itsLockMode);
+		status = itsMapping ? OpenMapped(path, *itsMapping, &ncId) : nc_open(path.c_str(), kNcReadOnly, &ncId);
+	}
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	// same settings as this handle, the mapping is shared and nothing is created
+	nc_open_options options = itsOptions;
+	options.itsMapped = false;
+	options.itsAlignment = 0;
+
+	std::shared_ptr<nc_file> ret = std::make_shared<nc_file>(ncId, itsLockMode, options, itsMapping, path);
+	ConfigureChunkCaches(*ret);
+
+	return ret;
+}
+
+void nc_file::Modified()
+{
+	++itsWrites;
+}
+
+/*
+ * Siblings are opened after every write through this handle was synced, one opened before a later write may not see
+ * it and is dropped instead of reused. Writes through other handles or processes are not tracked.
+ */
+
+std::shared_ptr<nc_file> nc_file::Sibling()
+{
+	// queued writes count before the comparison
+	Flush();
+
+	const size_t writes = itsWrites.load();
+	std::vector<std::shared_ptr<nc_file>> stale;
+
+	{
+		std::lock_guard<std::mutex> lock(itsSiblingMutex);
+
+		if(!itsSiblings.empty() && itsSiblings.back()->itsSiblingWrites == writes)
+		{
+			std::shared_ptr<nc_file> ret = itsSiblings.back();
+			itsSiblings.pop_back();
+			return ret;
+		}
+
+		// all idle siblings are opened before the same writes
+		stale.swap(itsSiblings);
+	}
+
+	// stale handles are closed outside the lock
+	stale.clear();
+
+	std::shared_ptr<nc_file> ret = Reopen();
+	ret->itsSiblingWrites = writes;
+
+	return ret;
+}
+
+void nc_file::Release(std::shared_ptr<nc_file> theSibling)
+{
+	if(theSibling->itsSiblingWrites != itsWrites.load())
+		return;
+
+	std::lock_guard<std::mutex> lock(itsSiblingMutex);
+	itsSiblings.push_back(theSibling);
+}
+
+std::vector<unsigned char> nc_file::CloseInMemory()
+{
+	if(!itsOptions.itsInMemory || itsClosed)
+		throw nc_error(NC_EINVAL);
+
+	itsWriteQueue.reset();
+
+	NC_memio memio;
+	int status;
+	{
+		auto lock = LibraryLock(itsLockMode);
+		status = nc_close_memio(itsNcId, &memio);
+	}
+
+	// handle is gone even if the library could not hand back the memory
+	itsClosed = true;
+
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	std::vector<unsigned char> ret(static_cast<unsigned char*>(memio.memory), static_cast<unsigned char*>(memio.memory) + memio.size);
+	free(memio.memory);
+
+	return ret;
+}
+
+void LockMode(NcLockMode theMode)
+{
+	lockMode.store(theMode);
+}
+
+NcLockMode LockMode()
+{
+	return lockMode.load();
+}
+
+/*
+ * Create file with data aligned in it. Alignment is a library wide setting, caller holds the library lock and
+ * the previous setting is restored afterwards.
+ */
+
+static int CreateAligned(const std::string& thePath, int theAlignment, int* theNcId)
+{
+#if NC_VERSION_MAJOR > 4 || (NC_VERSION_MAJOR == 4 && NC_VERSION_MINOR >= 9)
+	int threshold, alignment;
+	int status = nc_get_alignment(&threshold, &alignment);
+	if(status != NC_NOERR)
+		return status;
+
+	status = nc_set_alignment(theAlignment, theAlignment);
+	if(status != NC_NOERR)
+		return status;
+
+	status = nc_create(thePath.c_str(), kNc4, theNcId);
+
+	// once set the library passes the values to HDF5 on every open, where zero is invalid and one is the default
+	nc_set_alignment(std::max(threshold, 1), std::max(alignment, 1));
+
+	return status;
+#else
+	return NC_ENOTBUILT;
+#endif
+}
 
 /*
  * Create a new netcdf file
@@ -16,41 +420,180 @@ std::map<std::string, std::shared_ptr<nc_file>> fileCache;
  * Or should this operation just fail instead?
  */
 
-nc_group Create(const std::string& path)
+nc_group Create(const std::string& path, const nc_open_options& options)
 {
-	// Ensure thread safety
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsCreate, path, nullptr);
 
-	if(fileCache.count(path) == 0)
+	std::shared_ptr<nc_file> file = fileCache.Get(path, [&]()
 	{
         	int itsNcId;
-      		int status = nc_create(path.c_str(), kNc4, &itsNcId);
+		const NcLockMode mode = lockMode.load();
+		int status;
+		{
+			auto liblock = LibraryLock(mode);
+			if(options.itsInMemory)
+				status = nc_create_mem(path.c_str(), kNc4, 0, &itsNcId);
+			else if(options.itsAlignment > 0)
+				status = CreateAligned(path, static_cast<int>(options.itsAlignment), &itsNcId);
+			else
+				status = nc_create(path.c_str(), kNc4, &itsNcId);
+		}
 		if(status != NC_NOERR)
-			throw status;
-	  	fileCache[path] = std::make_shared<nc_file>(itsNcId);
-	}
-	return nc_group(fileCache[path], fileCache[path]->itsNcId);
+			throw nc_error(status);
+		return std::make_shared<nc_file>(itsNcId, mode, options, nullptr, path);
+	});
+
+	return nc_group(file, file->itsNcId);
 }
 
 /*
- * Open file in read-write mode
+ * Open file in read-write mode, or read-only from memory if mapping is requested
  */
 
-nc_group Open(const std::string& path)
+nc_group Open(const std::string& path, const nc_open_options& options)
 {
-	// Ensure thread safety
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsOpen, path, nullptr);
 
-	if(fileCache.count(path) == 0)
+	std::shared_ptr<nc_file> file = fileCache.Get(path, [&]()
 	{
 		int itsNcId;
-		int status = nc_open(path.c_str(), kNcShare, &itsNcId);
-        	if(status != NC_NOERR)
-                	throw status;
-        	fileCache[path] = std::make_shared<nc_file>(itsNcId);
+		const NcLockMode mode = lockMode.load();
+		std::shared_ptr<nc_mapping> mapping;
+		if(options.itsMapped)
+			mapping = std::make_shared<nc_mapping>(path);
+
+		int status;
+		{
+			auto liblock = LibraryLock(mode);
+			status = mapping ? OpenMapped(path, *mapping, &itsNcId) : nc_open(path.c_str(), kNcShare, &itsNcId);
+		}
+		if(status != NC_NOERR)
+			throw nc_error(status);
+		std::shared_ptr<nc_file> ret = std::make_shared<nc_file>(itsNcId, mode, options, mapping, path);
+
+		// layout of opened files is scanned once up front
+		ConfigureChunkCaches(*ret);
+		return ret;
+	});
+
+	return nc_group(file, file->itsNcId);
+}
+
+nc_group OpenUncached(const std::string& path)
+{
+	FMINC4_STATS_SCOPE(kNcStatsOpen, path, nullptr);
+
+	const NcLockMode mode = lockMode.load();
+
+	int ncId;
+	int status;
+	{
+		auto liblock = LibraryLock(mode);
+		status = nc_open(path.c_str(), kNcReadOnly, &ncId);
 	}
+	if(status != NC_NOERR)
+		throw nc_error(status);
 
-	return nc_group(fileCache[path], fileCache[path]->itsNcId);
+	std::shared_ptr<nc_file> file = std::make_shared<nc_file>(ncId, mode, nc_open_options(), nullptr, path);
+	return nc_group(file, file->itsNcId);
+}
+
+#ifdef FMINC4_HAVE_MPI
+// Options that do not apply to parallel files are turned off
+static nc_open_options ParOptions(const nc_open_options& theOptions)
+{
+	nc_open_options ret = theOptions;
+	ret.itsBlockCacheSize = 0; // other ranks write behind the cache
+	ret.itsParallelChunks = false; // chunks would be written through a serial HDF5 handle
+	ret.itsMapped = false;
+	ret.itsInMemory = false;
+	ret.itsAlignment = 0;
+
+	return ret;
+}
+
+/*
+ * Create a file shared by all ranks of the communicator, collective
+ */
+
+nc_group CreatePar(const std::string& path, MPI_Comm comm, MPI_Info info, const nc_open_options& theOptions)
+{
+	FMINC4_STATS_SCOPE(kNcStatsCreate, path, nullptr);
+
+	const nc_open_options options = ParOptions(theOptions);
+
+	std::shared_ptr<nc_file> file = fileCache.Get(path, [&]()
+	{
+		int itsNcId;
+		const NcLockMode mode = lockMode.load();
+		int status;
+		{
+			auto liblock = LibraryLock(mode);
+			status = nc_create_par(path.c_str(), kNc4, comm, info, &itsNcId);
+		}
+		if(status != NC_NOERR)
+			throw nc_error(status);
+		return std::make_shared<nc_file>(itsNcId, mode, options, nullptr, path, true);
+	});
+
+	return nc_group(file, file->itsNcId);
+}
+
+/*
+ * Open a file shared by all ranks of the communicator in read-write mode, collective
+ */
+
+nc_group OpenPar(const std::string& path, MPI_Comm comm, MPI_Info info, const nc_open_options& theOptions)
+{
+	FMINC4_STATS_SCOPE(kNcStatsOpen, path, nullptr);
+
+	const nc_open_options options = ParOptions(theOptions);
+
+	std::shared_ptr<nc_file> file = fileCache.Get(path, [&]()
+	{
+		int itsNcId;
+		const NcLockMode mode = lockMode.load();
+		int status;
+		{
+			auto liblock = LibraryLock(mode);
+			status = nc_open_par(path.c_str(), kNcReadWrite, comm, info, &itsNcId);
+		}
+		if(status != NC_NOERR)
+			throw nc_error(status);
+		std::shared_ptr<nc_file> ret = std::make_shared<nc_file>(itsNcId, mode, options, nullptr, path, true);
+
+		ConfigureChunkCaches(*ret);
+		return ret;
+	});
+
+	return nc_group(file, file->itsNcId);
+}
+#endif
+
+nc_group Open(const std::string& key, std::vector<unsigned char>&& buffer, const nc_open_options& options)
+{
+	FMINC4_STATS_SCOPE(kNcStatsOpen, key, nullptr);
+
+	std::shared_ptr<nc_file> file = fileCache.Get(key, [&]()
+	{
+		int itsNcId;
+		const NcLockMode mode = lockMode.load();
+		std::shared_ptr<nc_mapping> memory = std::make_shared<nc_mapping>(std::move(buffer));
+
+		int status;
+		{
+			auto liblock = LibraryLock(mode);
+			status = OpenMapped(key, *memory, &itsNcId);
+		}
+		if(status != NC_NOERR)
+			throw nc_error(status);
+		std::shared_ptr<nc_file> ret = std::make_shared<nc_file>(itsNcId, mode, options, memory, key);
+
+		ConfigureChunkCaches(*ret);
+		return ret;
+	});
+
+	return nc_group(file, file->itsNcId);
 }
 
 /*
@@ -61,24 +604,101 @@ nc_group Open(const std::string& path)
 
 bool Close(const std::string& path)
 {
-        // Ensure thread safety
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	std::shared_ptr<nc_file> file = fileCache.Find(path);
+	if(!file)
+		return false;
 
-	if(fileCache[path].use_count() == 1)
+	// pending asynchronous writes are written even if the file stays open
+	file->Flush();
+	file.reset();
+
+	return fileCache.Erase(path, 0);
+}
+
+bool Close(const std::string& key, std::vector<unsigned char>& bytes)
+{
+	std::shared_ptr<nc_file> file = fileCache.Find(key);
+	if(!file)
+		return false;
+
+	if(!file->itsOptions.itsInMemory)
+		throw nc_error(NC_EINVAL);
+
+	file->Flush();
+
+	if(!fileCache.Erase(key, 1))
+		return false;
+
+	// only reference left, nobody else can reach the handle anymore
+	bytes = file->CloseInMemory();
+	return true;
+}
+
+// System errors of looking up a file as netcdf status, so that callers see netcdf codes only
+static int StatStatus(int theErrno)
+{
+	switch(theErrno)
 	{
-                fileCache.erase(path);
-		return true;
+		case EACCES:
+		case EPERM:
+			return NC_EPERM;
+		case ENOMEM:
+			return NC_ENOMEM;
+		case ENOENT:
+		case ENOTDIR:
+			return NC_ENOTFOUND;
+		default:
+			return NC_EINVAL;
 	}
+}
+
+nc_catalogue Catalogue(const std::string& path)
+{
+	struct stat st;
+	if(stat(path.c_str(), &st) != 0)
+		throw nc_error(StatStatus(errno));
+
+	// taken before the walk, a file changed meanwhile does not match its sidecar next time
+	const uint64_t size = static_cast<uint64_t>(st.st_size);
+	const uint64_t time = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+	const std::string sidecar = path + kNcCatalogueSuffix;
 
-	return false;
+	nc_result<nc_catalogue> cached = nc_catalogue::Load(sidecar);
+	if(cached && cached.Value().itsSourceSize == size && cached.Value().itsSourceTime == time)
+		return std::move(cached).Value();
+
+	// a file not open already is walked read-only and stays out of the cache
+	std::shared_ptr<nc_file> file = fileCache.Find(path);
+
+	nc_catalogue ret = file ? nc_group(file, file->itsNcId).Walk() : OpenUncached(path).Walk();
+	ret.itsSourceSize = size;
+	ret.itsSourceTime = time;
+
+	try
+	{
+		ret.Save(sidecar);
+	}
+	catch(const nc_error&)
+	{
+	}
+
+	return ret;
 }
 
-void Finalize()
+void FileCacheLimits(size_t theMaxFiles, size_t theMaxIdleSeconds)
 {
-        // Ensure thread safety
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	fileCache.Limits(theMaxFiles, std::chrono::seconds(theMaxIdleSeconds));
+}
 
-        fileCache.clear();
+nc_file_cache_stats FileCacheStats()
+{
+	return fileCache.Stats();
+}
+
+void Finalize()
+{
+	fileCache.Clear();
 }
 
 } // end namespace
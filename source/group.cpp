@@ -1,58 +1,153 @@
 #include "group.h"
 #include "variable.h"
 #include "dimension.h"
+#include "metadata.h"
+#include "threadpool.h"
+#include "hyperslab.h"
+#include "stats.h"
+#include "attributes.h"
+#include <map>
+#include <set>
+#include <algorithm>
+#include <atomic>
+#include <netcdf_meta.h>
+
+#if defined(NC_HAS_ZSTD) && NC_HAS_ZSTD
+#include <netcdf_filter.h>
+#endif
 
 namespace fminc4
 {
-extern std::mutex netcdfLibMutex;
 
 nc_group::nc_group(std::shared_ptr<nc_file> theFile, int theGroupId) : itsFile(theFile), itsGroupId(theGroupId)
 {
 }
 
+// Sub groups
+nc_result<nc_group> nc_group::TryGetGroup(const std::string& theName)
+{
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	nc_result<std::shared_ptr<const nc_metadata>> scanned = itsFile->TryMetadata();
+	if(!scanned)
+		return nc_failure(scanned.Status());
+
+	auto metadata = scanned.Value();
+
+	int groupId = metadata->GroupId(itsGroupId, theName);
+	if (groupId < 0)
+	{
+		FMINC4_STATS_ERROR(NC_ENOGRP);
+		return nc_failure(NC_ENOGRP);
+	}
+
+	return nc_group(itsFile, groupId);
+}
+
+nc_group nc_group::GetGroup(const std::string& theName)
+{
+	return TryGetGroup(theName).Value();
+}
+
+nc_group nc_group::AddGroup(const std::string& theName)
+{
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	auto lock = itsFile->Lock();
+
+	int groupId;
+	int status = nc_def_grp(itsGroupId, theName.c_str(), &groupId);
+	if (status != NC_NOERR)
+		throw nc_error(status);
+
+	itsFile->Invalidate();
+
+	return nc_group(itsFile, groupId);
+}
+
+std::vector<std::string> nc_group::ListGroups() const
+{
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	auto metadata = itsFile->Metadata();
+
+	const nc_group_info* group = metadata->Group(itsGroupId);
+	if (!group)
+		throw nc_error(NC_ENOGRP);
+
+	std::vector<std::string> ret;
+	ret.reserve(group->itsGroupIds.size());
+
+	for (int groupId : group->itsGroupIds)
+		ret.push_back(metadata->Group(groupId)->itsName);
+
+	return ret;
+}
+// ---
+
 // Dimensions
-nc_dim nc_group::GetDim(const std::string& theName)
+nc_result<nc_dim> nc_group::TryGetDim(const std::string& theName)
 {
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	nc_result<std::shared_ptr<const nc_metadata>> scanned = itsFile->TryMetadata();
+	if(!scanned)
+		return nc_failure(scanned.Status());
 
-	int itsDimId;
-        int status = nc_inq_dimid(itsGroupId, theName.c_str(), &itsDimId);
-        if (status != NC_NOERR)
-                throw status;
+	auto metadata = scanned.Value();
 
-        return nc_dim(itsGroupId,itsDimId);
+	int itsDimId = metadata->DimId(itsGroupId, theName);
+	const nc_dim_info* dim = metadata->Dim(itsDimId);
+        if (!dim)
+	{
+		FMINC4_STATS_ERROR(NC_EBADDIM);
+                return nc_failure(NC_EBADDIM);
+	}
+
+        return nc_dim(itsFile, itsGroupId, itsDimId, dim->itsUnlimited ? 0 : dim->itsLength);
+}
+
+nc_dim nc_group::GetDim(const std::string& theName)
+{
+	return TryGetDim(theName).Value();
 }
 
 nc_dim nc_group::AddDim(const std::string& theName, size_t theSize)
 {
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+        auto lock = itsFile->Lock();
 
         int dimId;
         int status = nc_def_dim(itsGroupId, theName.c_str(), theSize, &dimId);
 	if (status != NC_NOERR)
-		throw status;
+		throw nc_error(status);
+
+	itsFile->Invalidate();
 
-	return nc_dim(itsGroupId,dimId);
+	return nc_dim(itsFile, itsGroupId, dimId, theSize);
 }
 
 std::vector<nc_dim> nc_group::ListDims() const
 {
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
 
-	int ndims;
+	auto metadata = itsFile->Metadata();
 
-	nc_inq_ndims(itsGroupId, &ndims);
-	int dimids[ndims];
-
-	int status = nc_inq_dimids(itsGroupId, &ndims, dimids, 0);
-	if (status != NC_NOERR)
-		throw status;
+	const nc_group_info* group = metadata->Group(itsGroupId);
+	if (!group)
+		throw nc_error(NC_ENOGRP);
 
 	std::vector<nc_dim> ret;
+	ret.reserve(group->itsDimIds.size());
 
-	for (int i = 0; i<ndims; ++i)
+	for (int dimId : group->itsDimIds)
 	{
-		ret.emplace_back(itsGroupId,dimids[i]);
+		const nc_dim_info* dim = metadata->Dim(dimId);
+		if (!dim)
+			throw nc_error(NC_EBADDIM);
+
+		ret.emplace_back(itsFile, itsGroupId, dimId, dim->itsUnlimited ? 0 : dim->itsLength);
 	}
 
 	return ret;
@@ -60,130 +155,590 @@ std::vector<nc_dim> nc_group::ListDims() const
 // ---
 
 // Variables
-nc_var nc_group::GetVar(const std::string& theName)
+nc_result<nc_var> nc_group::TryGetVar(const std::string& theName)
 {
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
 
-	int itsVarId;
-        nc_inq_varid(itsGroupId, theName.c_str(), &itsVarId);      
+	nc_result<std::shared_ptr<const nc_metadata>> scanned = itsFile->TryMetadata();
+	if(!scanned)
+		return nc_failure(scanned.Status());
 
-	return nc_var(itsGroupId, itsVarId);
+	auto metadata = scanned.Value();
+
+	int itsVarId = metadata->VarId(itsGroupId, theName);
+	if (itsVarId < 0)
+	{
+		FMINC4_STATS_ERROR(NC_ENOTVAR);
+		return nc_failure(NC_ENOTVAR);
+	}
+
+	return nc_var(itsFile, itsGroupId, itsVarId, itsFile->Layout(itsGroupId, itsVarId, *metadata->Var(itsGroupId, itsVarId)));
 }
 
-nc_var nc_group::AddVar(const std::string& theName, const std::vector<nc_dim>& theDims, const nc_type& theType)
+nc_var nc_group::GetVar(const std::string& theName)
 {
-        // ensure thread safety
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	return TryGetVar(theName).Value();
+}
+
+nc_var nc_group::AddVar(const std::string& theName, const std::vector<nc_dim>& theDims, const nc_type& theType, const nc_var_options& theOptions)
+{
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	// description of the new variable is known, no need to scan the file again
+	nc_var_info info;
+	info.itsName = theName;
+	info.itsType = theType;
 
         std::vector<int> itsDimIds;
+	std::vector<size_t> itsLengths;
         itsDimIds.reserve(theDims.size());
+	itsLengths.reserve(theDims.size());
         for(nc_dim dim : theDims)
+	{
                 itsDimIds.push_back(dim.DimId());
+		itsLengths.push_back(dim.Size());
+		info.itsLengths.push_back(dim.Unlimited() ? 0 : itsLengths.back());
+	}
+	info.itsDimIds = itsDimIds;
+
+        // ensure thread safety
+        auto lock = itsFile->Lock();
 
 	int itsVarId;
 
         int status = nc_def_var(itsGroupId, theName.c_str(), theType, itsDimIds.size(), itsDimIds.data(), &itsVarId);
         if(status != NC_NOERR)
-            throw status;
+            throw nc_error(status);
+
+	itsFile->Invalidate();
+
+	status = DefineStorage(itsGroupId, itsVarId, itsLengths, theType, theOptions);
+	if(status == NC_NOERR)
+		status = itsFile->ConfigureChunkCache(itsGroupId, itsVarId);
+	if(status == NC_NOERR)
+		status = itsFile->ConfigureParAccess(itsGroupId, itsVarId);
+	if(status != NC_NOERR)
+		throw nc_error(status);
 
-	return nc_var{itsGroupId,itsVarId};
+	return nc_var(itsFile, itsGroupId, itsVarId, itsFile->Layout(itsGroupId, itsVarId, info));
 }
 
 std::vector<nc_var> nc_group::ListVars() const
 {
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
 
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
-        int nvars;
+	auto metadata = itsFile->Metadata();
 
-        nc_inq_nvars(itsGroupId, &nvars);
-        int varids[nvars];
+	const nc_group_info* group = metadata->Group(itsGroupId);
+	if (!group)
+		throw nc_error(NC_ENOGRP);
 
-        int status = nc_inq_varids(itsGroupId, &nvars, varids);
+	const int nvars = static_cast<int>(group->itsVars.size());
 
         std::vector<nc_var> ret;
+	ret.reserve(nvars);
 
         for (int i = 0; i<nvars; ++i)
         {
-                ret.emplace_back(itsGroupId, varids[i]);
+                ret.emplace_back(itsFile, itsGroupId, i, itsFile->Layout(itsGroupId, i, group->itsVars[i]));
         }
 
         return ret;
 }
+/*
+ * Variables are resolved and buffers allocated up front through this handle, workers only read.
+ * Each worker opens its own handle so that workers do not contend on the lock of a shared handle.
+ */
+
+template <typename T>
+void nc_group::ReadMany(const std::vector<std::string>& theNames, std::vector<std::vector<T>>& theData, size_t theThreads)
+{
+	auto metadata = itsFile->Metadata();
+
+	std::vector<int> varIds;
+	std::vector<const nc_var_info*> infos;
+	std::vector<std::vector<size_t>> shapes;
+	varIds.reserve(theNames.size());
+	infos.reserve(theNames.size());
+	shapes.reserve(theNames.size());
+
+	theData.resize(theNames.size());
+
+	for(size_t i = 0; i < theNames.size(); ++i)
+	{
+		varIds.push_back(metadata->VarId(itsGroupId, theNames[i]));
+		if(varIds.back() < 0)
+			throw nc_error(NC_ENOTVAR);
+
+		// description is the same through every handle to the file and kept by this one
+		infos.push_back(itsFile->Layout(itsGroupId, varIds.back(), *metadata->Var(itsGroupId, varIds.back())));
+
+		nc_var var(itsFile, itsGroupId, varIds.back(), infos.back());
+		shapes.push_back(var.Shape());
+		theData[i].resize(Volume(shapes.back()));
+	}
+
+	// group path is the same in every handle, group id is not
+	std::string groupPath;
+	if(itsGroupId != itsFile->itsNcId)
+	{
+		auto lock = itsFile->Lock();
+
+		size_t len;
+		int status = nc_inq_grpname_full(itsGroupId, &len, NULL);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		std::vector<char> buffer(len + 1);
+		status = nc_inq_grpname_full(itsGroupId, &len, buffer.data());
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		groupPath.assign(buffer.data(), len);
+	}
+
+	// tasks of the pool must not wait for other tasks, called from one every variable is read here through this handle
+	const bool inWorker = nc_thread_pool::InWorker();
+
+	std::atomic<size_t> next(0);
+
+	auto worker = [&]()
+	{
+		// files created in memory exist only behind the one handle, parallel files are read through MPI-IO of this handle
+		std::shared_ptr<nc_file> file = itsFile->itsOptions.itsInMemory || itsFile->itsParallel || inWorker ? itsFile : itsFile->Sibling();
+
+		int groupId = file == itsFile ? itsGroupId : file->itsNcId;
+		if(file != itsFile && !groupPath.empty())
+		{
+			auto lock = file->Lock();
+
+			int status = nc_inq_grp_full_ncid(file->itsNcId, groupPath.c_str(), &groupId);
+			if(status != NC_NOERR)
+				throw nc_error(status);
+		}
+
+		for(size_t i = next++; i < varIds.size(); i = next++)
+		{
+			nc_var var(file, groupId, varIds[i], infos[i]);
+			var.Read(theData[i].data(), theData[i].size(), std::vector<size_t>(shapes[i].size(), 0), shapes[i]);
+		}
+
+		// kept open for the next call, a handle that failed is dropped
+		if(file != itsFile)
+			itsFile->Release(file);
+	};
+
+	if(inWorker)
+	{
+		worker();
+		return;
+	}
+
+	std::shared_ptr<nc_thread_pool> pool = ThreadPool();
+	const size_t workers = std::min(theThreads > 0 ? theThreads : pool->Size(), theNames.size());
+
+	std::vector<std::future<void>> results;
+	results.reserve(workers);
+
+	for(size_t w = 0; w < workers; ++w)
+		results.push_back(pool->Submit(worker));
+
+	// wait for every worker before rethrowing, workers refer to local state
+	for(auto& r : results)
+		r.wait();
+	for(auto& r : results)
+		r.get();
+}
+#define INSTANTIATE(T) template void nc_group::ReadMany<T>(const std::vector<std::string>&, std::vector<std::vector<T>>&, size_t);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
 // ---
 
 // Attributes
+// Values are converted from the type of the attribute, see ConvertAtt
+template <typename ATT_TYPE>
+nc_result<std::vector<ATT_TYPE>> nc_group::TryGetAtt(const std::string& name)
+{
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, nullptr);
+
+	nc_result<std::vector<ATT_TYPE>> ret = AttValues<ATT_TYPE>(*itsFile, itsGroupId, NC_GLOBAL, name);
+	FMINC4_STATS_ERROR(ret.Status());
+
+	return ret;
+}
+
 template <typename ATT_TYPE>
 std::vector<ATT_TYPE> nc_group::GetAtt(const std::string& name)
 {
-        // thread safety required?
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	return TryGetAtt<ATT_TYPE>(name).Value();
+}
+#define INSTANTIATE(T) \
+	template nc_result<std::vector<T>> nc_group::TryGetAtt<T>(const std::string&); \
+	template std::vector<T> nc_group::GetAtt<T>(const std::string&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+INSTANTIATE(std::string)
+#undef INSTANTIATE
+
+void nc_group::AddTextAtt(const std::string& name, const std::string& value)
+{
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, nullptr);
+	FMINC4_STATS_BYTES(value.size());
 
-        size_t attlen;
-        nc_inq_attlen(itsGroupId, NC_GLOBAL, name.c_str(), &attlen);
-        std::vector<ATT_TYPE> ret(attlen);
+	auto lock = itsFile->Lock();
 
-        nc_get_att(itsGroupId, NC_GLOBAL, name.c_str(), ret.data());
+	int status = nc_put_att_text(itsGroupId, NC_GLOBAL, name.c_str(), value.length(), value.c_str());
+	if(status != NC_NOERR)
+		throw nc_error(status);
 
-        return ret;
+	itsFile->Invalidate();
 }
-template std::vector<double> nc_group::GetAtt<double>(const std::string&);
 
-template <>
-std::vector<std::string> nc_group::GetAtt(const std::string& name)
+void nc_group::PutAtt(const std::string& name, nc_type type, size_t theLength, size_t theSize, const void* theValues)
 {
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, nullptr);
+	FMINC4_STATS_BYTES(theLength * theSize);
 
-        nc_type type;
-        int status = nc_inq_atttype(itsGroupId, NC_GLOBAL, name.c_str(), &type);
-        switch(type)
-        {
-                case NC_CHAR :  {
-                                        size_t attlen;
-                                        int status = nc_inq_attlen(itsGroupId, NC_GLOBAL, name.c_str(), &attlen);
-                                        char att[attlen];
-                                        status = nc_get_att(itsGroupId, NC_GLOBAL, name.c_str(), att);
-                                        return std::vector<std::string>{std::string(att)};
-                                }
-                case NC_STRING :{
-                                        std::vector<char*> chars = GetAtt<char*>(name);
-                                        std::vector<std::string> ret;
-                                        for(auto x : chars)
-                                        {
-                                                ret.emplace_back(x);
-                                        }
-                                        return ret;
-                                }
-        }
+	auto lock = itsFile->Lock();
+
+	int status = nc_put_att(itsGroupId, NC_GLOBAL, name.c_str(), type, theLength, theValues);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	itsFile->Invalidate();
 }
-template std::vector<std::string> nc_group::GetAtt<std::string>(const std::string&);
 
-template <typename ATT_TYPE>
-void nc_group::AddAtt(const std::string& name, const std::vector<ATT_TYPE>& values)
+void nc_group::AddAtt(const std::string& name, const std::vector<std::string>& values)
 {
-	//...
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, nullptr);
+
+	nc_att_schema att;
+	att.itsName = name;
+	att.itsType = NC_STRING;
+	att.itsLength = values.size();
+	att.itsStrings = values;
+
+	auto lock = itsFile->Lock();
+
+	int status = WriteAtt(itsGroupId, NC_GLOBAL, att);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	itsFile->Invalidate();
 }
 
 std::vector<std::tuple<std::string, nc_type, size_t>> nc_group::ListAtts() const
 {
-	std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	auto metadata = itsFile->Metadata();
 
-        int natts;
-	nc_inq_natts(itsGroupId, &natts);
+	const nc_group_info* group = metadata->Group(itsGroupId);
+	if (!group)
+		throw nc_error(NC_ENOGRP);
 
         std::vector<std::tuple<std::string, nc_type, size_t>> ret;
+	ret.reserve(group->itsAtts.size());
 
-        for (int i = 0; i<natts; ++i)
+        for (const nc_att_info& att : group->itsAtts)
         {
-                char recname[NC_MAX_NAME+1];
-		nc_type type;
-		size_t size;
-
-                nc_inq_attname(itsGroupId, NC_GLOBAL, i, recname);
-		nc_inq_att(itsGroupId, NC_GLOBAL, recname, &type, &size);
-                ret.emplace_back(recname, type, size);
+                ret.emplace_back(att.itsName, att.itsType, att.itsLength);
         }
 
         return ret;
 }
 //---
+
+// Schema
+
+// Values of attributes listed in the metadata snapshot. Caller holds the lock.
+static int GetAtts(int theNcId, int theVarId, const std::vector<nc_att_info>& theInfo, std::vector<nc_att_schema>& theAtts)
+{
+	for(const nc_att_info& info : theInfo)
+	{
+		nc_att_schema att;
+
+		int status = ReadAtt(theNcId, theVarId, info.itsName, att);
+		if(status != NC_NOERR)
+			return status;
+
+		theAtts.push_back(att);
+	}
+
+	return NC_NOERR;
+}
+
+// Chunk shape, filters and quantization of an existing variable, as far as the library can tell them. Caller holds the lock.
+static int GetStorage(int theNcId, int theVarId, size_t theDims, nc_var_options& theOptions)
+{
+	if(theDims > 0)
+	{
+		int storage;
+		std::vector<size_t> chunks(theDims);
+
+		int status = nc_inq_var_chunking(theNcId, theVarId, &storage, chunks.data());
+		if(status != NC_NOERR)
+			return status;
+
+		if(storage == NC_CHUNKED)
+			theOptions.itsChunks = chunks;
+	}
+
+	int shuffle, deflate, level;
+	int status = nc_inq_var_deflate(theNcId, theVarId, &shuffle, &deflate, &level);
+
+	// classic format has no filters
+	if(status == NC_ENOTNC4)
+		return NC_NOERR;
+	if(status != NC_NOERR)
+		return status;
+
+	theOptions.itsShuffle = shuffle != 0;
+	theOptions.itsDeflateLevel = deflate ? level : 0;
+
+#ifdef NC_QUANTIZE_BITGROOM
+	int quantize, digits;
+	status = nc_inq_var_quantize(theNcId, theVarId, &quantize, &digits);
+	if(status != NC_NOERR)
+		return status;
+
+	theOptions.itsQuantize = static_cast<NcQuantize>(quantize);
+	theOptions.itsQuantizeDigits = quantize == kNcQuantizeNone ? 0 : digits;
+#endif
+
+#if defined(NC_HAS_ZSTD) && NC_HAS_ZSTD
+	int zstd;
+	status = nc_inq_var_zstandard(theNcId, theVarId, &zstd, &level);
+	if(status != NC_NOERR)
+		return status;
+
+	theOptions.itsZstdLevel = zstd ? level : 0;
+#endif
+
+	return NC_NOERR;
+}
+
+// The group itself or the parent of it with the given path, the group itself if none has it
+static int OwnerGroup(const nc_metadata& theMetadata, int theGroupId, const std::string& thePath)
+{
+	for(int groupId = theGroupId; groupId >= 0;)
+	{
+		if(theMetadata.Path(groupId) == thePath)
+			return groupId;
+
+		const nc_group_info* group = theMetadata.Group(groupId);
+		groupId = group ? group->itsParentId : -1;
+	}
+
+	return theGroupId;
+}
+
+// Dimension of a parent group used by a variable of the group, with the path of the parent defining it
+static nc_dim_schema InheritedDim(const nc_metadata& theMetadata, int theGroupId, int theDimId, const nc_dim_info& theDim)
+{
+	nc_dim_schema ret;
+	ret.itsName = theDim.itsName;
+	ret.itsLength = theDim.itsUnlimited ? 0 : theDim.itsLength;
+
+	for(int groupId = theGroupId; groupId >= 0;)
+	{
+		const nc_group_info* group = theMetadata.Group(groupId);
+		if(!group)
+			break;
+
+		if(std::find(group->itsDimIds.begin(), group->itsDimIds.end(), theDimId) != group->itsDimIds.end())
+		{
+			ret.itsGroup = theMetadata.Path(groupId);
+			break;
+		}
+
+		groupId = group->itsParentId;
+	}
+
+	return ret;
+}
+
+/*
+ * Dimensions are defined first so that variables can refer to them by name, dimensions not in the schema are looked up
+ * from the metadata snapshot taken before the lock. Dimensions of parent groups are reused if already there, see
+ * nc_schema. Define mode is left once at the end.
+ */
+
+static int DefineSchema(nc_file& theFile, int theGroupId, const nc_metadata& theMetadata, const nc_schema& theSchema)
+{
+	std::map<std::string, std::pair<int, size_t>> dims; // id and length (0 for unlimited) by name
+	int status;
+
+	for(const nc_dim_schema& dim : theSchema.itsDims)
+	{
+		int groupId = theGroupId;
+		if(!dim.itsGroup.empty())
+		{
+			// a dimension of the group itself with the same name hides it
+			if(dims.count(dim.itsName))
+				continue;
+
+			groupId = OwnerGroup(theMetadata, theGroupId, dim.itsGroup);
+
+			const int dimId = theMetadata.DimId(groupId, dim.itsName);
+			const nc_dim_info* info = theMetadata.Dim(dimId);
+			if(info)
+			{
+				dims[dim.itsName] = std::make_pair(dimId, info->itsUnlimited ? 0 : info->itsLength);
+				continue;
+			}
+		}
+
+		int dimId;
+		status = nc_def_dim(groupId, dim.itsName.c_str(), dim.itsLength, &dimId);
+		if(status != NC_NOERR)
+			return status;
+
+		dims[dim.itsName] = std::make_pair(dimId, dim.itsLength);
+	}
+
+	for(const nc_att_schema& att : theSchema.itsAtts)
+	{
+		status = WriteAtt(theGroupId, NC_GLOBAL, att);
+		if(status != NC_NOERR)
+			return status;
+	}
+
+	for(const nc_var_schema& var : theSchema.itsVars)
+	{
+		std::vector<int> dimIds;
+		std::vector<size_t> lengths;
+
+		for(const std::string& name : var.itsDims)
+		{
+			auto it = dims.find(name);
+			if(it == dims.end())
+			{
+				const int dimId = theMetadata.DimId(theGroupId, name);
+				const nc_dim_info* dim = theMetadata.Dim(dimId);
+				if(!dim)
+					return NC_EBADDIM;
+
+				it = dims.insert(std::make_pair(name, std::make_pair(dimId, dim->itsUnlimited ? 0 : dim->itsLength))).first;
+			}
+
+			dimIds.push_back(it->second.first);
+			lengths.push_back(it->second.second);
+		}
+
+		int varId;
+		status = nc_def_var(theGroupId, var.itsName.c_str(), var.itsType, static_cast<int>(dimIds.size()), dimIds.data(), &varId);
+		if(status != NC_NOERR)
+			return status;
+
+		status = DefineStorage(theGroupId, varId, lengths, var.itsType, var.itsOptions);
+		if(status == NC_NOERR)
+			status = theFile.ConfigureChunkCache(theGroupId, varId);
+		if(status == NC_NOERR)
+			status = theFile.ConfigureParAccess(theGroupId, varId);
+		if(status != NC_NOERR)
+			return status;
+
+		for(const nc_att_schema& att : var.itsAtts)
+		{
+			status = WriteAtt(theGroupId, varId, att);
+			if(status != NC_NOERR)
+				return status;
+		}
+	}
+
+	status = nc_enddef(theGroupId);
+
+	return status == NC_ENOTINDEFINE ? NC_NOERR : status;
+}
+
+void nc_group::Define(const nc_schema& theSchema)
+{
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	auto metadata = itsFile->Metadata();
+
+	int status;
+	{
+		auto lock = itsFile->Lock();
+		status = DefineSchema(*itsFile, itsGroupId, *metadata, theSchema);
+	}
+
+	// whatever got defined before a failure is in the file
+	itsFile->Invalidate();
+
+	if(status != NC_NOERR)
+		throw nc_error(status);
+}
+
+nc_schema nc_group::Schema() const
+{
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	auto metadata = itsFile->Metadata();
+
+	const nc_group_info* group = metadata->Group(itsGroupId);
+	if(!group)
+		throw nc_error(NC_ENOGRP);
+
+	nc_schema ret;
+
+	for(int dimId : group->itsDimIds)
+	{
+		const nc_dim_info* dim = metadata->Dim(dimId);
+		if(!dim)
+			throw nc_error(NC_EBADDIM);
+
+		ret.AddDim(dim->itsName, dim->itsUnlimited ? 0 : dim->itsLength);
+	}
+
+	auto lock = itsFile->Lock();
+
+	int status = GetAtts(itsGroupId, NC_GLOBAL, group->itsAtts, ret.itsAtts);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	std::set<int> inherited;
+
+	for(size_t varId = 0; varId < group->itsVars.size(); ++varId)
+	{
+		const nc_var_info& info = group->itsVars[varId];
+
+		nc_var_schema var;
+		var.itsName = info.itsName;
+		var.itsType = info.itsType;
+
+		for(int dimId : info.itsDimIds)
+		{
+			const nc_dim_info* dim = metadata->Dim(dimId);
+			if(!dim)
+				throw nc_error(NC_EBADDIM);
+
+			var.itsDims.push_back(dim->itsName);
+
+			if(std::find(group->itsDimIds.begin(), group->itsDimIds.end(), dimId) == group->itsDimIds.end() && inherited.insert(dimId).second)
+				ret.itsDims.push_back(InheritedDim(*metadata, itsGroupId, dimId, *dim));
+		}
+
+		status = GetStorage(itsGroupId, static_cast<int>(varId), info.itsDimIds.size(), var.itsOptions);
+		if(status == NC_NOERR)
+			status = GetAtts(itsGroupId, static_cast<int>(varId), info.itsAtts, var.itsAtts);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		ret.itsVars.push_back(var);
+	}
+
+	return ret;
+}
+//---
+
+// Catalogue
+nc_catalogue nc_group::Walk() const
+{
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, nullptr);
+
+	return WalkGroup(*itsFile, itsGroupId);
+}
+//---
 } // end namespace
@@ -0,0 +1,91 @@
+#include "hyperslab.h"
+#include <algorithm>
+#include <cstring>
+
+namespace fminc4
+{
+
+size_t Volume(const std::vector<size_t>& theCount)
+{
+	size_t ret = 1;
+	for(size_t x : theCount)
+		ret *= x;
+
+	return ret;
+}
+
+bool Intersect(const std::vector<size_t>& theStartA, const std::vector<size_t>& theCountA,
+		const std::vector<size_t>& theStartB, const std::vector<size_t>& theCountB,
+		std::vector<size_t>& theStart, std::vector<size_t>& theCount)
+{
+	const size_t n = theStartA.size();
+	theStart.resize(n);
+	theCount.resize(n);
+
+	for(size_t i = 0; i < n; ++i)
+	{
+		const size_t first = std::max(theStartA[i], theStartB[i]);
+		const size_t last = std::min(theStartA[i] + theCountA[i], theStartB[i] + theCountB[i]);
+
+		if(first >= last)
+			return false;
+
+		theStart[i] = first;
+		theCount[i] = last - first;
+	}
+
+	return true;
+}
+
+// Offset of index in a row-major hyperslab, in elements
+static size_t Offset(const std::vector<size_t>& theIndex, const std::vector<size_t>& theStart, const std::vector<size_t>& theCount)
+{
+	size_t ret = 0;
+	for(size_t i = 0; i < theIndex.size(); ++i)
+		ret = ret * theCount[i] + (theIndex[i] - theStart[i]);
+
+	return ret;
+}
+
+void CopyHyperslab(const void* theSrc, const std::vector<size_t>& theSrcStart, const std::vector<size_t>& theSrcCount,
+		void* theDst, const std::vector<size_t>& theDstStart, const std::vector<size_t>& theDstCount,
+		const std::vector<size_t>& theStart, const std::vector<size_t>& theCount, size_t theElementSize)
+{
+	const unsigned char* src = static_cast<const unsigned char*>(theSrc);
+	unsigned char* dst = static_cast<unsigned char*>(theDst);
+
+	const size_t n = theStart.size();
+
+	// scalar variable
+	if(n == 0)
+	{
+		std::memcpy(dst, src, theElementSize);
+		return;
+	}
+
+	// copy rows along the fastest varying dimension, iterate the others like an odometer
+	const size_t row = theCount[n - 1] * theElementSize;
+	std::vector<size_t> index(theStart);
+
+	while(true)
+	{
+		std::memcpy(dst + Offset(index, theDstStart, theDstCount) * theElementSize, src + Offset(index, theSrcStart, theSrcCount) * theElementSize, row);
+
+		size_t i = n - 1;
+		while(i > 0)
+		{
+			--i;
+			if(++index[i] < theStart[i] + theCount[i])
+				break;
+
+			index[i] = theStart[i];
+			if(i == 0)
+				return;
+		}
+
+		if(n == 1)
+			return;
+	}
+}
+
+} // end namespace
@@ -0,0 +1,850 @@
+#include "index.h"
+#include "attributes.h"
+#include "catalogue.h"
+#include "fminc4.h"
+#include "group.h"
+#include "mapping.h"
+#include "variable.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fminc4
+{
+
+/*
+ * Index file: header, then tables of fixed size records and the strings they refer to. Records have only 8 byte
+ * fields and tables start at multiples of 8 bytes, so they are used in place in the mapped file. Variables are
+ * sorted by name and file, a query is a binary search. Records are checked when used, not when the file is mapped,
+ * so that opening a large index touches only the pages a query needs. Numbers are written as they are in memory,
+ * an index of other byte order is not recognized and rebuilt.
+ */
+
+static const char kMagic[8] = {'F', 'M', 'I', 'N', 'C', '4', 'I', 'X'};
+static const uint32_t kVersion = 1;
+static const uint32_t kByteOrder = 0x01020304;
+
+struct index_header
+{
+	char itsMagic[8];
+	uint32_t itsVersion;
+	uint32_t itsByteOrder;
+	uint64_t itsFiles;
+	uint64_t itsEntries;
+	uint64_t itsDims;
+	uint64_t itsAtts;
+	uint64_t itsStrings; // bytes
+};
+
+struct index_string
+{
+	uint64_t itsOffset;
+	uint64_t itsLength;
+};
+
+struct index_file
+{
+	index_string itsPath;
+	uint64_t itsSize;
+	uint64_t itsTime;
+};
+
+struct index_entry
+{
+	uint64_t itsFile;
+	index_string itsName;
+	index_string itsGroup;
+	int64_t itsType;
+	uint64_t itsFirstDim;
+	uint64_t itsDims;
+	uint64_t itsFirstAtt;
+	uint64_t itsAtts;
+	double itsTimeFrom;
+	double itsTimeTo;
+};
+
+struct index_dim
+{
+	index_string itsName;
+	uint64_t itsLength;
+	double itsMin;
+	double itsMax;
+};
+
+struct index_att
+{
+	index_string itsName;
+	index_string itsValue;
+};
+
+static size_t Aligned(size_t theSize)
+{
+	return (theSize + 7) & ~static_cast<size_t>(7);
+}
+
+// Bytes of a table of theCount records, or more than theLimit if the table cannot fit
+static size_t TableSize(uint64_t theCount, size_t theRecord, size_t theLimit)
+{
+	return theCount > theLimit / theRecord ? theLimit + 1 : Aligned(static_cast<size_t>(theCount) * theRecord);
+}
+
+/*
+ * Index file mapped into memory, or nothing for an empty index.
+ */
+
+class nc_index_table
+{
+	public:
+	nc_index_table() : itsHeader(nullptr), itsFiles(nullptr), itsEntries(nullptr), itsDims(nullptr), itsAtts(nullptr), itsStrings(nullptr) {}
+	explicit nc_index_table(const std::string& thePath); // throws nc_error, NC_ENOTNC if not an index of this version
+
+	size_t Files() const { return itsHeader ? itsHeader->itsFiles : 0; }
+	size_t Entries() const { return itsHeader ? itsHeader->itsEntries : 0; }
+
+	const index_file& File(size_t theFile) const { return itsFiles[theFile]; }
+	const index_entry& Entry(size_t theEntry) const { return itsEntries[theEntry]; }
+
+	std::string String(const index_string&) const; // empty if out of range
+	int Compare(const index_string&, const std::string&) const;
+
+	std::pair<size_t, size_t> Find(const std::string& theVar) const; // entries of the variable
+	const index_dim* Dim(const index_entry&, const std::string& theName) const; // nullptr if not found
+	bool Decode(size_t theEntry, nc_index_entry&) const; // false if the entry refers outside the tables
+
+	private:
+	std::shared_ptr<nc_mapping> itsMapping;
+	const index_header* itsHeader;
+	const index_file* itsFiles;
+	const index_entry* itsEntries;
+	const index_dim* itsDims;
+	const index_att* itsAtts;
+	const char* itsStrings;
+};
+
+nc_index_table::nc_index_table(const std::string& thePath) : nc_index_table()
+{
+	itsMapping = std::make_shared<nc_mapping>(thePath);
+
+	const char* data = static_cast<const char*>(itsMapping->Data());
+	const size_t size = itsMapping->Size();
+
+	if(size < sizeof(index_header))
+		throw nc_error(NC_ENOTNC);
+
+	const index_header* header = reinterpret_cast<const index_header*>(data);
+	if(std::memcmp(header->itsMagic, kMagic, sizeof(kMagic)) != 0 || header->itsVersion != kVersion || header->itsByteOrder != kByteOrder)
+		throw nc_error(NC_ENOTNC);
+
+	size_t offset = Aligned(sizeof(index_header));
+	const size_t files = offset;
+	offset += TableSize(header->itsFiles, sizeof(index_file), size);
+	const size_t entries = offset;
+	offset += TableSize(header->itsEntries, sizeof(index_entry), size);
+	const size_t dims = offset;
+	offset += TableSize(header->itsDims, sizeof(index_dim), size);
+	const size_t atts = offset;
+	offset += TableSize(header->itsAtts, sizeof(index_att), size);
+	const size_t strings = offset;
+
+	if(offset > size || header->itsStrings != size - strings)
+		throw nc_error(NC_ENOTNC);
+
+	itsHeader = header;
+	itsFiles = reinterpret_cast<const index_file*>(data + files);
+	itsEntries = reinterpret_cast<const index_entry*>(data + entries);
+	itsDims = reinterpret_cast<const index_dim*>(data + dims);
+	itsAtts = reinterpret_cast<const index_att*>(data + atts);
+	itsStrings = data + strings;
+}
+
+std::string nc_index_table::String(const index_string& theString) const
+{
+	if(!itsHeader || theString.itsOffset > itsHeader->itsStrings || theString.itsLength > itsHeader->itsStrings - theString.itsOffset)
+		return std::string();
+
+	return std::string(itsStrings + theString.itsOffset, theString.itsLength);
+}
+
+int nc_index_table::Compare(const index_string& theString, const std::string& theValue) const
+{
+	// strings out of range compare as empty
+	const char* data = itsStrings;
+	size_t length = 0;
+	if(itsHeader && theString.itsOffset <= itsHeader->itsStrings && theString.itsLength <= itsHeader->itsStrings - theString.itsOffset)
+	{
+		data += theString.itsOffset;
+		length = theString.itsLength;
+	}
+
+	int ret = length == 0 ? 0 : std::memcmp(data, theValue.data(), std::min(length, theValue.size()));
+	if(ret != 0)
+		return ret;
+
+	return length < theValue.size() ? -1 : (length > theValue.size() ? 1 : 0);
+}
+
+std::pair<size_t, size_t> nc_index_table::Find(const std::string& theVar) const
+{
+	size_t first = 0;
+	size_t last = Entries();
+
+	while(first < last)
+	{
+		const size_t middle = first + (last - first) / 2;
+		if(Compare(itsEntries[middle].itsName, theVar) < 0)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	size_t end = first;
+	while(end < Entries() && Compare(itsEntries[end].itsName, theVar) == 0)
+		++end;
+
+	return std::make_pair(first, end);
+}
+
+const index_dim* nc_index_table::Dim(const index_entry& theEntry, const std::string& theName) const
+{
+	if(theEntry.itsFirstDim > itsHeader->itsDims || theEntry.itsDims > itsHeader->itsDims - theEntry.itsFirstDim)
+		return nullptr;
+
+	for(size_t i = 0; i < theEntry.itsDims; ++i)
+	{
+		const index_dim& dim = itsDims[theEntry.itsFirstDim + i];
+		if(Compare(dim.itsName, theName) == 0)
+			return &dim;
+	}
+
+	return nullptr;
+}
+
+bool nc_index_table::Decode(size_t theEntry, nc_index_entry& theResult) const
+{
+	const index_entry& entry = itsEntries[theEntry];
+
+	if(entry.itsFile >= itsHeader->itsFiles ||
+	   entry.itsFirstDim > itsHeader->itsDims || entry.itsDims > itsHeader->itsDims - entry.itsFirstDim ||
+	   entry.itsFirstAtt > itsHeader->itsAtts || entry.itsAtts > itsHeader->itsAtts - entry.itsFirstAtt)
+		return false;
+
+	theResult.itsFile = String(itsFiles[entry.itsFile].itsPath);
+	theResult.itsGroup = String(entry.itsGroup);
+	theResult.itsName = String(entry.itsName);
+	theResult.itsType = static_cast<nc_type>(entry.itsType);
+	theResult.itsTimeFrom = entry.itsTimeFrom;
+	theResult.itsTimeTo = entry.itsTimeTo;
+
+	theResult.itsDims.clear();
+	for(size_t i = 0; i < entry.itsDims; ++i)
+	{
+		const index_dim& dim = itsDims[entry.itsFirstDim + i];
+
+		nc_index_dim d;
+		d.itsName = String(dim.itsName);
+		d.itsLength = dim.itsLength;
+		d.itsMin = dim.itsMin;
+		d.itsMax = dim.itsMax;
+		theResult.itsDims.push_back(d);
+	}
+
+	theResult.itsAtts.clear();
+	for(size_t i = 0; i < entry.itsAtts; ++i)
+	{
+		const index_att& att = itsAtts[entry.itsFirstAtt + i];
+		theResult.itsAtts.emplace_back(String(att.itsName), String(att.itsValue));
+	}
+
+	return true;
+}
+
+// Files to be written to an index
+struct index_source
+{
+	std::string itsPath;
+	uint64_t itsSize;
+	uint64_t itsTime;
+	std::vector<nc_index_entry> itsEntries;
+};
+
+// Strings are written once however many records refer to them
+class index_strings
+{
+	public:
+	index_string Add(const std::string& theValue)
+	{
+		auto it = itsOffsets.find(theValue);
+		if(it == itsOffsets.end())
+		{
+			it = itsOffsets.insert(std::make_pair(theValue, static_cast<uint64_t>(itsData.size()))).first;
+			itsData.append(theValue);
+		}
+
+		index_string ret;
+		ret.itsOffset = it->second;
+		ret.itsLength = theValue.size();
+		return ret;
+	}
+
+	const std::string& Data() const { return itsData; }
+
+	private:
+	std::string itsData;
+	std::unordered_map<std::string, uint64_t> itsOffsets;
+};
+
+template<typename T>
+static void Append(std::string& theData, const std::vector<T>& theRecords)
+{
+	theData.append(reinterpret_cast<const char*>(theRecords.data()), theRecords.size() * sizeof(T));
+	theData.resize(Aligned(theData.size()), '\0');
+}
+
+static std::string Serialize(const std::vector<index_source>& theSources)
+{
+	index_strings strings;
+
+	std::vector<index_file> files;
+	files.reserve(theSources.size());
+
+	std::vector<std::pair<uint64_t, const nc_index_entry*>> order;
+
+	for(size_t i = 0; i < theSources.size(); ++i)
+	{
+		index_file file;
+		file.itsPath = strings.Add(theSources[i].itsPath);
+		file.itsSize = theSources[i].itsSize;
+		file.itsTime = theSources[i].itsTime;
+		files.push_back(file);
+
+		for(const nc_index_entry& entry : theSources[i].itsEntries)
+			order.push_back(std::make_pair(static_cast<uint64_t>(i), &entry));
+	}
+
+	std::stable_sort(order.begin(), order.end(), [](const std::pair<uint64_t, const nc_index_entry*>& a, const std::pair<uint64_t, const nc_index_entry*>& b)
+	{
+		return a.second->itsName < b.second->itsName;
+	});
+
+	std::vector<index_entry> entries;
+	std::vector<index_dim> dims;
+	std::vector<index_att> atts;
+	entries.reserve(order.size());
+
+	for(const auto& source : order)
+	{
+		const nc_index_entry& e = *source.second;
+
+		index_entry entry;
+		entry.itsFile = source.first;
+		entry.itsName = strings.Add(e.itsName);
+		entry.itsGroup = strings.Add(e.itsGroup);
+		entry.itsType = e.itsType;
+		entry.itsFirstDim = dims.size();
+		entry.itsDims = e.itsDims.size();
+		entry.itsFirstAtt = atts.size();
+		entry.itsAtts = e.itsAtts.size();
+		entry.itsTimeFrom = e.itsTimeFrom;
+		entry.itsTimeTo = e.itsTimeTo;
+		entries.push_back(entry);
+
+		for(const nc_index_dim& d : e.itsDims)
+		{
+			index_dim dim;
+			dim.itsName = strings.Add(d.itsName);
+			dim.itsLength = d.itsLength;
+			dim.itsMin = d.itsMin;
+			dim.itsMax = d.itsMax;
+			dims.push_back(dim);
+		}
+
+		for(const auto& a : e.itsAtts)
+		{
+			index_att att;
+			att.itsName = strings.Add(a.first);
+			att.itsValue = strings.Add(a.second);
+			atts.push_back(att);
+		}
+	}
+
+	index_header header;
+	std::memcpy(header.itsMagic, kMagic, sizeof(kMagic));
+	header.itsVersion = kVersion;
+	header.itsByteOrder = kByteOrder;
+	header.itsFiles = files.size();
+	header.itsEntries = entries.size();
+	header.itsDims = dims.size();
+	header.itsAtts = atts.size();
+	header.itsStrings = strings.Data().size();
+
+	std::string ret(reinterpret_cast<const char*>(&header), sizeof(header));
+	ret.resize(Aligned(ret.size()), '\0');
+
+	Append(ret, files);
+	Append(ret, entries);
+	Append(ret, dims);
+	Append(ret, atts);
+	ret.append(strings.Data());
+
+	return ret;
+}
+
+/*
+ * Valid time from CF units "<unit> since <date> [time] [offset]", e.g. "hours since 2024-01-01 00:00:00". An offset
+ * from UTC after the time (Z, UTC, +03:00, -6:00, +0300) is applied. Anything else after the reference time and
+ * calendars other than the gregorian one are not handled, such coordinates give no valid time.
+ */
+
+// Days from 1970-01-01 in the proleptic gregorian calendar
+static long DaysFromCivil(long y, unsigned m, unsigned d)
+{
+	y -= m <= 2;
+	const long era = (y >= 0 ? y : y - 399) / 400;
+	const unsigned yoe = static_cast<unsigned>(y - era * 400);
+	const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + static_cast<long>(doe) - 719468;
+}
+
+static bool TimeUnits(const std::string& theUnits, double& theScale, double& theEpoch)
+{
+	const size_t since = theUnits.find(" since ");
+	if(since == std::string::npos)
+		return false;
+
+	std::string unit = theUnits.substr(0, since);
+	unit.erase(0, unit.find_first_not_of(' '));
+	std::transform(unit.begin(), unit.end(), unit.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+	if(unit == "seconds" || unit == "second" || unit == "secs" || unit == "sec" || unit == "s")
+		theScale = 1;
+	else if(unit == "minutes" || unit == "minute" || unit == "mins" || unit == "min")
+		theScale = 60;
+	else if(unit == "hours" || unit == "hour" || unit == "hrs" || unit == "hr" || unit == "h")
+		theScale = 3600;
+	else if(unit == "days" || unit == "day" || unit == "d")
+		theScale = 86400;
+	else
+		return false;
+
+	const char* reference = theUnits.c_str() + since + 7;
+
+	int year, month, day, n = 0;
+	if(std::sscanf(reference, " %d-%d-%d%n", &year, &month, &day, &n) != 3 || month < 1 || month > 12 || day < 1 || day > 31)
+		return false;
+
+	reference += n;
+	if(*reference == 'T' || *reference == ' ')
+		++reference;
+
+	int hour = 0, minute = 0;
+	double second = 0;
+	if(std::isdigit(static_cast<unsigned char>(*reference)) && std::sscanf(reference, "%d:%d%n", &hour, &minute, &n) == 2)
+	{
+		reference += n;
+		if(*reference == ':' && std::sscanf(reference + 1, "%lf%n", &second, &n) == 1)
+			reference += 1 + n;
+	}
+
+	while(*reference == ' ')
+		++reference;
+
+	int offset = 0; // seconds east of UTC
+	if(*reference == '+' || *reference == '-')
+	{
+		const int sign = *reference == '-' ? -1 : 1;
+		++reference;
+
+		int hours = 0, minutes = 0;
+		if(!std::isdigit(static_cast<unsigned char>(*reference)) || std::sscanf(reference, "%2d%n", &hours, &n) != 1)
+			return false;
+
+		reference += n;
+		if(*reference == ':')
+			++reference;
+
+		if(std::isdigit(static_cast<unsigned char>(*reference)))
+		{
+			if(std::sscanf(reference, "%2d%n", &minutes, &n) != 1)
+				return false;
+			reference += n;
+		}
+
+		if(hours > 23 || minutes > 59)
+			return false;
+
+		offset = sign * (hours * 3600 + minutes * 60);
+	}
+	else if(*reference == 'Z')
+		++reference;
+	else if(std::strncmp(reference, "UTC", 3) == 0 || std::strncmp(reference, "GMT", 3) == 0)
+		reference += 3;
+
+	while(*reference == ' ')
+		++reference;
+
+	// a time zone given by name, or something else that is not understood
+	if(*reference != '\0')
+		return false;
+
+	theEpoch = static_cast<double>(DaysFromCivil(year, month, day)) * 86400 + hour * 3600 + minute * 60 + second - offset;
+	return true;
+}
+
+// Range of values of a coordinate variable, and of its valid times if it is a time coordinate
+struct index_coordinate
+{
+	double itsMin;
+	double itsMax;
+	double itsTimeFrom;
+	double itsTimeTo;
+};
+
+// Text value of an attribute of a variable in the catalogue, empty if not found or not text
+static std::string TextAtt(const nc_catalogue& theCatalogue, const nc_catalogue_var& theVar, const std::string& theName)
+{
+	for(size_t i = 0; i < theVar.itsAtts; ++i)
+	{
+		const nc_att_schema& att = theCatalogue.itsAtts[theVar.itsFirstAtt + i];
+		if(att.itsName != theName)
+			continue;
+
+		std::vector<std::string> values;
+		if(ConvertAtt(att, values) != NC_NOERR || values.empty())
+			return std::string();
+
+		return values[0];
+	}
+
+	return std::string();
+}
+
+// Coordinate variable of a dimension: one dimensional variable of the same name in the group or its parents.
+// Returns -1 if there is none, theOwner is the group of the coordinate variable.
+static int CoordinateVar(const nc_catalogue& theCatalogue, int theGroup, const std::string& theDim, int& theOwner)
+{
+	for(theOwner = theGroup; theOwner >= 0; theOwner = theCatalogue.itsGroups[theOwner].itsParent)
+	{
+		const int var = theCatalogue.Var(theOwner, theDim);
+		if(var >= 0 && theCatalogue.itsVars[var].itsDims == 1 && theCatalogue.VarDim(theCatalogue.itsVars[var], 0).itsName == theDim)
+			return var;
+	}
+
+	return -1;
+}
+
+static nc_group GroupAt(nc_group theRoot, const std::string& thePath)
+{
+	nc_group ret = theRoot;
+
+	for(size_t begin = 1; begin < thePath.size();)
+	{
+		size_t end = thePath.find('/', begin);
+		if(end == std::string::npos)
+			end = thePath.size();
+
+		ret = ret.GetGroup(thePath.substr(begin, end - begin));
+		begin = end + 1;
+	}
+
+	return ret;
+}
+
+static index_coordinate ReadCoordinate(nc_group theRoot, const nc_catalogue& theCatalogue, int theGroup, int theVar)
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const nc_catalogue_var& info = theCatalogue.itsVars[theVar];
+
+	index_coordinate ret = {nan, nan, nan, nan};
+
+	nc_var var = GroupAt(theRoot, theCatalogue.itsGroups[theGroup].itsPath).GetVar(info.itsName);
+	std::vector<double> values;
+	if(info.itsType != NC_CHAR && info.itsType != NC_STRING && info.itsType < NC_FIRSTUSERTYPEID)
+		values = var.Read<double>();
+
+	for(double value : values)
+	{
+		if(std::isnan(value))
+			continue;
+
+		ret.itsMin = std::isnan(ret.itsMin) ? value : std::min(ret.itsMin, value);
+		ret.itsMax = std::isnan(ret.itsMax) ? value : std::max(ret.itsMax, value);
+	}
+
+	const std::string calendar = TextAtt(theCatalogue, info, "calendar");
+	const bool gregorian = calendar.empty() || calendar == "standard" || calendar == "gregorian" || calendar == "proleptic_gregorian";
+
+	double scale, epoch;
+	if(!std::isnan(ret.itsMin) && gregorian && TimeUnits(TextAtt(theCatalogue, info, "units"), scale, epoch))
+	{
+		ret.itsTimeFrom = epoch + ret.itsMin * scale;
+		ret.itsTimeTo = epoch + ret.itsMax * scale;
+	}
+
+	return ret;
+}
+
+// Variables of a file with coordinate ranges, each coordinate variable is read once
+static std::vector<nc_index_entry> Scan(const std::string& thePath, const std::vector<std::string>& theKeyAtts)
+{
+	nc_group root = OpenUncached(thePath);
+	const nc_catalogue catalogue = root.Walk();
+
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	std::map<int, index_coordinate> coordinates; // by catalogue variable
+
+	std::vector<nc_index_entry> ret;
+	ret.reserve(catalogue.itsVars.size());
+
+	for(size_t g = 0; g < catalogue.itsGroups.size(); ++g)
+	{
+		const nc_catalogue_group& group = catalogue.itsGroups[g];
+
+		for(size_t v = group.itsFirstVar; v < group.itsFirstVar + group.itsVars; ++v)
+		{
+			const nc_catalogue_var& var = catalogue.itsVars[v];
+
+			nc_index_entry entry;
+			entry.itsFile = thePath;
+			entry.itsGroup = group.itsPath;
+			entry.itsName = var.itsName;
+			entry.itsType = var.itsType;
+			entry.itsTimeFrom = nan;
+			entry.itsTimeTo = nan;
+
+			for(size_t d = 0; d < var.itsDims; ++d)
+			{
+				const nc_catalogue_dim& dim = catalogue.VarDim(var, d);
+
+				nc_index_dim info;
+				info.itsName = dim.itsName;
+				info.itsLength = dim.itsLength;
+				info.itsMin = nan;
+				info.itsMax = nan;
+
+				int owner;
+				const int coordinate = CoordinateVar(catalogue, static_cast<int>(g), dim.itsName, owner);
+				if(coordinate >= 0)
+				{
+					auto it = coordinates.find(coordinate);
+					if(it == coordinates.end())
+						it = coordinates.insert(std::make_pair(coordinate, ReadCoordinate(root, catalogue, owner, coordinate))).first;
+
+					info.itsMin = it->second.itsMin;
+					info.itsMax = it->second.itsMax;
+
+					// first time coordinate gives the valid times
+					if(std::isnan(entry.itsTimeFrom) && !std::isnan(it->second.itsTimeFrom))
+					{
+						entry.itsTimeFrom = it->second.itsTimeFrom;
+						entry.itsTimeTo = it->second.itsTimeTo;
+					}
+				}
+
+				entry.itsDims.push_back(info);
+			}
+
+			for(const std::string& name : theKeyAtts)
+			{
+				const std::string value = TextAtt(catalogue, var, name);
+				if(!value.empty())
+					entry.itsAtts.emplace_back(name, value);
+			}
+
+			ret.push_back(entry);
+		}
+	}
+
+	return ret;
+}
+
+// Size and modification time (ns) of a file, errno if not found
+static int Stamp(const std::string& thePath, uint64_t& theSize, uint64_t& theTime)
+{
+	struct stat st;
+	if(stat(thePath.c_str(), &st) != 0)
+		return errno;
+
+	theSize = static_cast<uint64_t>(st.st_size);
+	theTime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	return 0;
+}
+
+nc_index::nc_index(const std::string& thePath, const std::vector<std::string>& theKeyAtts) : itsPath(thePath), itsKeyAtts(theKeyAtts)
+{
+	std::shared_ptr<const nc_index_table> table;
+	try
+	{
+		table = std::make_shared<nc_index_table>(thePath);
+	}
+	catch(const nc_error&)
+	{
+		table = std::make_shared<nc_index_table>();
+	}
+
+	std::atomic_store(&itsTable, table);
+}
+
+nc_index_update nc_index::Update(const std::vector<std::string>& theFiles)
+{
+	std::lock_guard<std::mutex> lock(itsUpdateMutex);
+
+	std::shared_ptr<const nc_index_table> table = std::atomic_load(&itsTable);
+
+	std::unordered_map<std::string, size_t> indexed; // file by path
+	std::vector<std::vector<size_t>> entries(table->Files()); // entries by file
+
+	for(size_t i = 0; i < table->Files(); ++i)
+		indexed[table->String(table->File(i).itsPath)] = i;
+
+	for(size_t i = 0; i < table->Entries(); ++i)
+	{
+		const uint64_t file = table->Entry(i).itsFile;
+		if(file < entries.size())
+			entries[file].push_back(i);
+	}
+
+	nc_index_update ret;
+	ret.itsKept = 0;
+	ret.itsScanned = 0;
+
+	std::vector<index_source> sources;
+	sources.reserve(theFiles.size());
+	std::unordered_set<std::string> seen;
+
+	for(const std::string& path : theFiles)
+	{
+		if(!seen.insert(path).second)
+			continue;
+
+		index_source source;
+		source.itsPath = path;
+
+		// taken before the scan, a file changed meanwhile is scanned again next time
+		int status = Stamp(path, source.itsSize, source.itsTime);
+		if(status != 0)
+		{
+			ret.itsFailed.emplace_back(path, status);
+			continue;
+		}
+
+		auto it = indexed.find(path);
+		bool kept = it != indexed.end() && table->File(it->second).itsSize == source.itsSize && table->File(it->second).itsTime == source.itsTime;
+
+		if(kept)
+		{
+			source.itsEntries.resize(entries[it->second].size());
+			for(size_t i = 0; i < source.itsEntries.size() && kept; ++i)
+				kept = table->Decode(entries[it->second][i], source.itsEntries[i]);
+		}
+
+		if(kept)
+			++ret.itsKept;
+		else
+		{
+			try
+			{
+				source.itsEntries = Scan(path, itsKeyAtts);
+				++ret.itsScanned;
+			}
+			catch(const nc_error& e)
+			{
+				ret.itsFailed.emplace_back(path, e.Status());
+				continue;
+			}
+		}
+
+		sources.push_back(std::move(source));
+	}
+
+	ReplaceFile(itsPath, Serialize(sources));
+
+	std::atomic_store(&itsTable, std::shared_ptr<const nc_index_table>(std::make_shared<nc_index_table>(itsPath)));
+
+	return ret;
+}
+
+// Files with an entry of the variable that is accepted, each file once
+template<typename ACCEPT>
+static std::vector<std::string> Matching(const nc_index_table& theTable, const std::string& theVar, ACCEPT theAccept)
+{
+	std::vector<std::string> ret;
+	uint64_t last = std::numeric_limits<uint64_t>::max();
+
+	const std::pair<size_t, size_t> range = theTable.Find(theVar);
+	for(size_t i = range.first; i < range.second; ++i)
+	{
+		const index_entry& entry = theTable.Entry(i);
+
+		// entries of a variable are in file order
+		if(entry.itsFile == last || entry.itsFile >= theTable.Files() || !theAccept(entry))
+			continue;
+
+		last = entry.itsFile;
+		ret.push_back(theTable.String(theTable.File(entry.itsFile).itsPath));
+	}
+
+	return ret;
+}
+
+std::vector<std::string> nc_index::Files(const std::string& theVar) const
+{
+	std::shared_ptr<const nc_index_table> table = std::atomic_load(&itsTable);
+
+	return Matching(*table, theVar, [](const index_entry&) { return true; });
+}
+
+std::vector<std::string> nc_index::Files(const std::string& theVar, double theFrom, double theTo) const
+{
+	std::shared_ptr<const nc_index_table> table = std::atomic_load(&itsTable);
+
+	// entries without valid times compare false
+	return Matching(*table, theVar, [&](const index_entry& theEntry)
+	{
+		return theEntry.itsTimeFrom <= theTo && theEntry.itsTimeTo >= theFrom;
+	});
+}
+
+std::vector<std::string> nc_index::Files(const std::string& theVar, const std::string& theDim, double theMin, double theMax) const
+{
+	std::shared_ptr<const nc_index_table> table = std::atomic_load(&itsTable);
+
+	return Matching(*table, theVar, [&](const index_entry& theEntry)
+	{
+		const index_dim* dim = table->Dim(theEntry, theDim);
+		return dim && dim->itsMin <= theMax && dim->itsMax >= theMin;
+	});
+}
+
+std::vector<nc_index_entry> nc_index::Entries(const std::string& theVar) const
+{
+	std::shared_ptr<const nc_index_table> table = std::atomic_load(&itsTable);
+
+	std::vector<nc_index_entry> ret;
+
+	const std::pair<size_t, size_t> range = table->Find(theVar);
+	for(size_t i = range.first; i < range.second; ++i)
+	{
+		nc_index_entry entry;
+		if(table->Decode(i, entry))
+			ret.push_back(entry);
+	}
+
+	return ret;
+}
+
+size_t nc_index::Size() const
+{
+	return std::atomic_load(&itsTable)->Files();
+}
+
+} // end namespace fminc4
@@ -0,0 +1,191 @@
+#include "mapping.h"
+#include "error.h"
+#include "fminc4.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <netcdf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef FMINC4_HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+namespace fminc4
+{
+
+// System errors of mapping a file as netcdf status, so that callers see netcdf codes only
+static int MappingStatus(int theErrno)
+{
+	switch(theErrno)
+	{
+		case EACCES:
+		case EPERM:
+			return NC_EPERM;
+		case ENOMEM:
+			return NC_ENOMEM;
+		default:
+			return NC_ENOTNC;
+	}
+}
+
+nc_mapping::nc_mapping(const std::string& thePath) : itsPath(thePath), itsData(nullptr), itsSize(0)
+{
+	int fd = open(thePath.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw nc_error(MappingStatus(errno));
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		int error = errno;
+		close(fd);
+		throw nc_error(MappingStatus(error));
+	}
+
+	// nothing to map, let the library report the file as invalid
+	if(st.st_size == 0)
+	{
+		close(fd);
+		throw nc_error(NC_ENOTNC);
+	}
+
+	itsSize = static_cast<size_t>(st.st_size);
+	itsData = mmap(nullptr, itsSize, PROT_READ, MAP_SHARED, fd, 0);
+
+	// mapping stays valid after the descriptor is closed
+	int error = errno;
+	close(fd);
+
+	if(itsData == MAP_FAILED)
+		throw nc_error(MappingStatus(error));
+}
+
+nc_mapping::nc_mapping(std::vector<unsigned char>&& theBuffer) : itsData(nullptr), itsSize(0), itsBuffer(std::move(theBuffer))
+{
+	if(itsBuffer.empty())
+		throw nc_error(NC_ENOTNC);
+
+	itsData = itsBuffer.data();
+	itsSize = itsBuffer.size();
+}
+
+nc_mapping::~nc_mapping()
+{
+	if(itsBuffer.empty())
+		munmap(itsData, itsSize);
+}
+
+const void* nc_mapping::Data() const
+{
+	return itsData;
+}
+
+size_t nc_mapping::Size() const
+{
+	return itsSize;
+}
+
+#ifdef FMINC4_HAVE_HDF5
+
+/*
+ * libnetcdf does not expose storage addresses, the file is opened a second time through HDF5 to ask for them.
+ * HDF5 only gives an address for contiguous datasets that have been allocated, filters require chunked storage.
+ */
+
+static int LookupOffset(const std::string& thePath, const std::string& theVarPath, size_t& theOffset)
+{
+	hid_t file = H5Fopen(thePath.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+	if(file < 0)
+		return NC_EHDFERR;
+
+	int status = NC_EINVAL;
+
+	hid_t dataset = H5Dopen(file, theVarPath.c_str(), H5P_DEFAULT);
+	if(dataset >= 0)
+	{
+		haddr_t address = H5Dget_offset(dataset);
+		if(address != HADDR_UNDEF)
+		{
+			theOffset = static_cast<size_t>(address);
+			status = NC_NOERR;
+		}
+
+		H5Dclose(dataset);
+	}
+
+	H5Fclose(file);
+
+	return status;
+}
+
+#else
+
+static int LookupOffset(const std::string&, const std::string&, size_t&)
+{
+	return NC_ENOTBUILT;
+}
+
+#endif
+
+void ReplaceFile(const std::string& thePath, const std::string& theData)
+{
+	// unique per writer, processes and threads may replace the same file
+	static std::atomic<unsigned> serial(0);
+	const std::string tmp = thePath + ".tmp" + std::to_string(getpid()) + "." + std::to_string(serial++);
+
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+		throw nc_error(errno);
+
+	for(size_t pos = 0; pos < theData.size();)
+	{
+		ssize_t n = write(fd, theData.data() + pos, theData.size() - pos);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n < 0)
+		{
+			int error = errno;
+			close(fd);
+			unlink(tmp.c_str());
+			throw nc_error(error);
+		}
+		pos += static_cast<size_t>(n);
+	}
+
+	if(close(fd) != 0 || rename(tmp.c_str(), thePath.c_str()) != 0)
+	{
+		int error = errno;
+		unlink(tmp.c_str());
+		throw nc_error(error);
+	}
+}
+
+int nc_mapping::Offset(const std::string& theVarPath, NcLockMode theLockMode, size_t& theOffset)
+{
+	std::lock_guard<std::mutex> lock(itsMutex);
+
+	// buffers have no file to ask from
+	if(itsPath.empty())
+		return NC_EINVAL;
+
+	auto it = itsOffsets.find(theVarPath);
+	if(it == itsOffsets.end())
+	{
+		size_t offset = 0;
+		int status;
+		{
+			auto liblock = LibraryLock(theLockMode);
+			status = LookupOffset(itsPath, theVarPath, offset);
+		}
+		it = itsOffsets.insert(std::make_pair(theVarPath, std::make_pair(status, offset))).first;
+	}
+
+	theOffset = it->second.second;
+	return it->second.first;
+}
+
+} // end namespace
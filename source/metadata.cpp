@@ -0,0 +1,229 @@
+#include "metadata.h"
+#include <algorithm>
+
+namespace fminc4
+{
+
+static std::vector<nc_att_info> ScanAtts(int theNcId, int theVarId, int theAttCount)
+{
+	std::vector<nc_att_info> ret;
+	ret.reserve(theAttCount);
+
+	for(int i = 0; i < theAttCount; ++i)
+	{
+		char recname[NC_MAX_NAME+1];
+		nc_att_info att;
+
+		int status = nc_inq_attname(theNcId, theVarId, i, recname);
+		if(status == NC_NOERR)
+			status = nc_inq_att(theNcId, theVarId, recname, &att.itsType, &att.itsLength);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		att.itsName = recname;
+		ret.push_back(att);
+	}
+
+	return ret;
+}
+
+std::shared_ptr<const nc_metadata> nc_metadata::Scan(int theNcId)
+{
+	std::shared_ptr<nc_metadata> ret = std::make_shared<nc_metadata>();
+	ret->ScanGroup(theNcId, -1);
+	return ret;
+}
+
+void nc_metadata::ScanGroup(int theGroupId, int theParentId)
+{
+	nc_group_info& group = itsGroups[theGroupId];
+	group.itsParentId = theParentId;
+
+	int status;
+
+	char groupname[NC_MAX_NAME+1];
+	status = nc_inq_grpname(theGroupId, groupname);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	group.itsName = groupname;
+
+	// dimensions
+	int ndims, nunlim;
+	status = nc_inq_dimids(theGroupId, &ndims, NULL, 0);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	group.itsDimIds.resize(ndims);
+	status = nc_inq_dimids(theGroupId, &ndims, group.itsDimIds.data(), 0);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	status = nc_inq_unlimdims(theGroupId, &nunlim, NULL);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	std::vector<int> unlimited(nunlim);
+	status = nc_inq_unlimdims(theGroupId, &nunlim, unlimited.data());
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	for(int dimId : group.itsDimIds)
+	{
+		char recname[NC_MAX_NAME+1];
+		nc_dim_info dim;
+
+		status = nc_inq_dim(theGroupId, dimId, recname, &dim.itsLength);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		dim.itsName = recname;
+		dim.itsUnlimited = std::find(unlimited.begin(), unlimited.end(), dimId) != unlimited.end();
+
+		group.itsDimNames[dim.itsName] = dimId;
+		itsDims[dimId] = dim;
+	}
+
+	// variables
+	int nvars;
+	status = nc_inq_nvars(theGroupId, &nvars);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	group.itsVars.resize(nvars);
+
+	for(int varId = 0; varId < nvars; ++varId)
+	{
+		char recname[NC_MAX_NAME+1];
+		int vardims, natts;
+		nc_var_info& var = group.itsVars[varId];
+
+		status = nc_inq_var(theGroupId, varId, recname, &var.itsType, &vardims, NULL, &natts);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		var.itsName = recname;
+		var.itsDimIds.resize(vardims);
+
+		status = nc_inq_vardimid(theGroupId, varId, var.itsDimIds.data());
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		// dimensions of this and parent groups are scanned already
+		for(int dimId : var.itsDimIds)
+		{
+			auto dim = itsDims.find(dimId);
+			if(dim == itsDims.end())
+				throw nc_error(NC_EBADDIM);
+
+			var.itsLengths.push_back(dim->second.itsUnlimited ? 0 : dim->second.itsLength);
+		}
+
+		var.itsAtts = ScanAtts(theGroupId, varId, natts);
+		group.itsVarNames[var.itsName] = varId;
+	}
+
+	// group attributes
+	int natts;
+	status = nc_inq_natts(theGroupId, &natts);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	group.itsAtts = ScanAtts(theGroupId, NC_GLOBAL, natts);
+
+	// sub groups, not present in classic files
+	int ngroups;
+	status = nc_inq_grps(theGroupId, &ngroups, NULL);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	std::vector<int> groupIds(ngroups);
+	status = nc_inq_grps(theGroupId, &ngroups, groupIds.data());
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	group.itsGroupIds = groupIds;
+
+	// references to elements stay valid while the map grows
+	for(int groupId : groupIds)
+	{
+		ScanGroup(groupId, theGroupId);
+		group.itsGroupNames[itsGroups[groupId].itsName] = groupId;
+	}
+}
+
+const nc_group_info* nc_metadata::Group(int theGroupId) const
+{
+	auto it = itsGroups.find(theGroupId);
+	return it == itsGroups.end() ? nullptr : &it->second;
+}
+
+const std::unordered_map<int, nc_group_info>& nc_metadata::Groups() const
+{
+	return itsGroups;
+}
+
+const nc_dim_info* nc_metadata::Dim(int theDimId) const
+{
+	auto it = itsDims.find(theDimId);
+	return it == itsDims.end() ? nullptr : &it->second;
+}
+
+const nc_var_info* nc_metadata::Var(int theGroupId, int theVarId) const
+{
+	const nc_group_info* group = Group(theGroupId);
+	if(!group || theVarId < 0 || theVarId >= static_cast<int>(group->itsVars.size()))
+		return nullptr;
+
+	return &group->itsVars[theVarId];
+}
+
+int nc_metadata::DimId(int theGroupId, const std::string& theName) const
+{
+	for(const nc_group_info* group = Group(theGroupId); group; group = Group(group->itsParentId))
+	{
+		auto it = group->itsDimNames.find(theName);
+		if(it != group->itsDimNames.end())
+			return it->second;
+	}
+
+	return -1;
+}
+
+int nc_metadata::VarId(int theGroupId, const std::string& theName) const
+{
+	const nc_group_info* group = Group(theGroupId);
+	if(!group)
+		return -1;
+
+	auto it = group->itsVarNames.find(theName);
+	return it == group->itsVarNames.end() ? -1 : it->second;
+}
+
+int nc_metadata::GroupId(int theGroupId, const std::string& theName) const
+{
+	const nc_group_info* group = Group(theGroupId);
+	if(!group)
+		return -1;
+
+	auto it = group->itsGroupNames.find(theName);
+	return it == group->itsGroupNames.end() ? -1 : it->second;
+}
+
+std::string nc_metadata::Path(int theGroupId) const
+{
+	const nc_group_info* group = Group(theGroupId);
+	if(!group)
+		return std::string();
+
+	if(group->itsParentId < 0)
+		return "/";
+
+	const std::string parent = Path(group->itsParentId);
+	if(parent.empty())
+		return parent;
+
+	return (parent == "/" ? parent : parent + "/") + group->itsName;
+}
+
+} // end namespace
@@ -0,0 +1,181 @@
+#include "packing.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FMINC4_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace fminc4
+{
+
+#ifdef FMINC4_X86_KERNELS
+
+/*
+ * Kernels are compiled for their instruction set through target attributes and picked at runtime,
+ * the library itself is built for the baseline architecture.
+ */
+
+__attribute__((target("avx2")))
+static void UnpackAvx2(const short* theSrc, size_t theSize, float* theDst, const nc_packing& thePacking)
+{
+	const __m256 scale = _mm256_set1_ps(static_cast<float>(thePacking.itsScale));
+	const __m256 offset = _mm256_set1_ps(static_cast<float>(thePacking.itsOffset));
+	const __m256 nan = _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN());
+	const __m256i fill = _mm256_set1_epi32(static_cast<short>(thePacking.itsFill));
+
+	size_t i = 0;
+	for(; i + 8 <= theSize; i += 8)
+	{
+		const __m256i packed = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(theSrc + i)));
+		__m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(packed), scale), offset);
+
+		if(thePacking.itsHasFill)
+			value = _mm256_blendv_ps(value, nan, _mm256_castsi256_ps(_mm256_cmpeq_epi32(packed, fill)));
+
+		_mm256_storeu_ps(theDst + i, value);
+	}
+
+	UnpackScalar(theSrc + i, theSize - i, theDst + i, thePacking);
+}
+
+__attribute__((target("avx2")))
+static void UnpackAvx2(const short* theSrc, size_t theSize, double* theDst, const nc_packing& thePacking)
+{
+	const __m256d scale = _mm256_set1_pd(thePacking.itsScale);
+	const __m256d offset = _mm256_set1_pd(thePacking.itsOffset);
+	const __m256d nan = _mm256_set1_pd(std::numeric_limits<double>::quiet_NaN());
+	const __m128i fill = _mm_set1_epi32(static_cast<short>(thePacking.itsFill));
+
+	size_t i = 0;
+	for(; i + 4 <= theSize; i += 4)
+	{
+		const __m128i packed = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(theSrc + i)));
+		__m256d value = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(packed), scale), offset);
+
+		if(thePacking.itsHasFill)
+			value = _mm256_blendv_pd(value, nan, _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(packed, fill))));
+
+		_mm256_storeu_pd(theDst + i, value);
+	}
+
+	UnpackScalar(theSrc + i, theSize - i, theDst + i, thePacking);
+}
+
+__attribute__((target("avx512f")))
+static void UnpackAvx512(const short* theSrc, size_t theSize, float* theDst, const nc_packing& thePacking)
+{
+	const __m512 scale = _mm512_set1_ps(static_cast<float>(thePacking.itsScale));
+	const __m512 offset = _mm512_set1_ps(static_cast<float>(thePacking.itsOffset));
+	const __m512 nan = _mm512_set1_ps(std::numeric_limits<float>::quiet_NaN());
+	const __m512i fill = _mm512_set1_epi32(static_cast<short>(thePacking.itsFill));
+
+	size_t i = 0;
+	for(; i + 16 <= theSize; i += 16)
+	{
+		const __m512i packed = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(theSrc + i)));
+		__m512 value = _mm512_add_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(packed), scale), offset);
+
+		if(thePacking.itsHasFill)
+			value = _mm512_mask_blend_ps(_mm512_cmpeq_epi32_mask(packed, fill), value, nan);
+
+		_mm512_storeu_ps(theDst + i, value);
+	}
+
+	UnpackScalar(theSrc + i, theSize - i, theDst + i, thePacking);
+}
+
+__attribute__((target("avx512f")))
+static void UnpackAvx512(const short* theSrc, size_t theSize, double* theDst, const nc_packing& thePacking)
+{
+	const __m512d scale = _mm512_set1_pd(thePacking.itsScale);
+	const __m512d offset = _mm512_set1_pd(thePacking.itsOffset);
+	const __m512d nan = _mm512_set1_pd(std::numeric_limits<double>::quiet_NaN());
+	const __m512i fill = _mm512_set1_epi64(static_cast<short>(thePacking.itsFill));
+
+	size_t i = 0;
+	for(; i + 8 <= theSize; i += 8)
+	{
+		const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(theSrc + i));
+		__m512d value = _mm512_add_pd(_mm512_mul_pd(_mm512_cvtepi32_pd(_mm256_cvtepi16_epi32(packed)), scale), offset);
+
+		if(thePacking.itsHasFill)
+			value = _mm512_mask_blend_pd(_mm512_cmpeq_epi64_mask(_mm512_cvtepi16_epi64(packed), fill), value, nan);
+
+		_mm512_storeu_pd(theDst + i, value);
+	}
+
+	UnpackScalar(theSrc + i, theSize - i, theDst + i, thePacking);
+}
+
+enum kernel
+{
+	kScalar,
+	kAvx2,
+	kAvx512
+};
+
+static kernel Kernel()
+{
+	static const kernel ret = __builtin_cpu_supports("avx512f") ? kAvx512 : __builtin_cpu_supports("avx2") ? kAvx2 : kScalar;
+	return ret;
+}
+
+void Unpack(const short* theSrc, size_t theSize, float* theDst, const nc_packing& thePacking)
+{
+	switch(Kernel())
+	{
+		case kAvx512:
+			return UnpackAvx512(theSrc, theSize, theDst, thePacking);
+		case kAvx2:
+			return UnpackAvx2(theSrc, theSize, theDst, thePacking);
+		default:
+			return UnpackScalar(theSrc, theSize, theDst, thePacking);
+	}
+}
+
+void Unpack(const short* theSrc, size_t theSize, double* theDst, const nc_packing& thePacking)
+{
+	switch(Kernel())
+	{
+		case kAvx512:
+			return UnpackAvx512(theSrc, theSize, theDst, thePacking);
+		case kAvx2:
+			return UnpackAvx2(theSrc, theSize, theDst, thePacking);
+		default:
+			return UnpackScalar(theSrc, theSize, theDst, thePacking);
+	}
+}
+
+const char* UnpackKernel()
+{
+	switch(Kernel())
+	{
+		case kAvx512:
+			return "avx512";
+		case kAvx2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+#else
+
+void Unpack(const short* theSrc, size_t theSize, float* theDst, const nc_packing& thePacking)
+{
+	UnpackScalar(theSrc, theSize, theDst, thePacking);
+}
+
+void Unpack(const short* theSrc, size_t theSize, double* theDst, const nc_packing& thePacking)
+{
+	UnpackScalar(theSrc, theSize, theDst, thePacking);
+}
+
+const char* UnpackKernel()
+{
+	return "scalar";
+}
+
+#endif
+
+} // end namespace
@@ -0,0 +1,149 @@
+#include "records.h"
+#include "hyperslab.h"
+#include "threadpool.h"
+#include <algorithm>
+
+namespace fminc4
+{
+
+template <typename T>
+nc_record_reader<T>::nc_record_reader(const nc_var& theVar, size_t theBlock, size_t theStart)
+	: itsVar(theVar), itsBlock(theBlock), itsRecord(theStart), itsCount(0), itsNext(std::make_shared<std::vector<T>>()), itsNextRecord(0), itsNextCount(0)
+{
+	if(itsBlock == 0)
+		throw nc_error(NC_EINVAL);
+}
+
+template <typename T>
+nc_record_reader<T>::~nc_record_reader()
+{
+	if(itsPending.valid())
+		itsPending.wait();
+}
+
+/*
+ * Nothing is read before the first Next() so that a fresh reader can be moved around freely.
+ * Background read only touches the shared buffer and a copy of the variable.
+ */
+
+template <typename T>
+void nc_record_reader<T>::Prefetch(size_t theRecord)
+{
+	std::vector<size_t> start = itsVar.Shape();
+	if(start.empty())
+		throw nc_error(NC_EINVAL);
+
+	const size_t records = start[0];
+	if(theRecord >= records)
+		return;
+
+	std::vector<size_t> count = start;
+	count[0] = std::min(itsBlock, records - theRecord);
+	std::fill(start.begin(), start.end(), 0);
+	start[0] = theRecord;
+
+	itsNextRecord = theRecord;
+	itsNextCount = count[0];
+
+	nc_var var = itsVar;
+	std::shared_ptr<std::vector<T>> buffer = itsNext;
+
+	std::function<void()> read = [var, buffer, start, count]() mutable
+	{
+		buffer->resize(Volume(count));
+		var.Read(buffer->data(), buffer->size(), start, count);
+	};
+
+	// tasks of the pool must not wait for other tasks, a reader used from one reads the block here
+	if(nc_thread_pool::InWorker())
+	{
+		std::packaged_task<void()> task(read);
+		itsPending = task.get_future();
+		task();
+		return;
+	}
+
+	itsPending = ThreadPool()->Submit(read);
+}
+
+template <typename T>
+bool nc_record_reader<T>::Next()
+{
+	// first block, or records appended after the end was reached
+	if(!itsPending.valid())
+		Prefetch(itsRecord + itsCount);
+
+	if(!itsPending.valid())
+		return false;
+
+	itsPending.get();
+
+	itsData.swap(*itsNext);
+	itsRecord = itsNextRecord;
+	itsCount = itsNextCount;
+
+	Prefetch(itsRecord + itsCount);
+
+	return true;
+}
+
+#define INSTANTIATE(T) template class nc_record_reader<T>;
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+nc_record_appender<T>::nc_record_appender(const nc_var& theVar) : itsVar(theVar)
+{
+	itsCount = itsVar.Shape();
+	if(itsCount.empty())
+		throw nc_error(NC_EINVAL);
+
+	itsNext = itsCount[0];
+	itsCount[0] = 1;
+	itsRecordLength = Volume(itsCount);
+}
+
+template <typename T>
+void nc_record_appender<T>::Append(const T* data, size_t size)
+{
+	if(itsRecordLength == 0 || size == 0 || size % itsRecordLength != 0)
+		throw nc_error(NC_EINVAL);
+
+	std::vector<size_t> start(itsCount.size(), 0);
+	std::vector<size_t> count = itsCount;
+	start[0] = itsNext;
+	count[0] = size / itsRecordLength;
+
+	itsVar.Write(data, size, start, count);
+	itsNext += count[0];
+}
+
+template <typename T>
+void nc_record_appender<T>::Append(const std::vector<T>& data)
+{
+	Append(data.data(), data.size());
+}
+
+#define INSTANTIATE(T) template class nc_record_appender<T>;
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+nc_record_reader<T> nc_var::Records(size_t theBlock, size_t theStart)
+{
+	return nc_record_reader<T>(*this, theBlock, theStart);
+}
+#define INSTANTIATE(T) template nc_record_reader<T> nc_var::Records<T>(size_t, size_t);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+nc_record_appender<T> nc_var::Appender()
+{
+	return nc_record_appender<T>(*this);
+}
+#define INSTANTIATE(T) template nc_record_appender<T> nc_var::Appender<T>();
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+} // end namespace
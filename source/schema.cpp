@@ -0,0 +1,54 @@
+#include "schema.h"
+
+namespace fminc4
+{
+
+nc_schema& nc_schema::AddDim(const std::string& theName, size_t theLength)
+{
+	nc_dim_schema dim;
+	dim.itsName = theName;
+	dim.itsLength = theLength;
+
+	itsDims.push_back(dim);
+	return *this;
+}
+
+nc_schema& nc_schema::AddVar(const std::string& theName, const std::vector<std::string>& theDims, nc_type theType, const nc_var_options& theOptions)
+{
+	nc_var_schema var;
+	var.itsName = theName;
+	var.itsType = theType;
+	var.itsDims = theDims;
+	var.itsOptions = theOptions;
+
+	itsVars.push_back(var);
+	return *this;
+}
+
+nc_schema& nc_schema::AddTextAtt(const std::string& theVar, const std::string& theName, const std::string& theValue)
+{
+	nc_att_schema att;
+	att.itsName = theName;
+	att.itsType = NC_CHAR;
+	att.itsLength = theValue.size();
+	att.itsValues.assign(theValue.begin(), theValue.end());
+
+	Atts(theVar).push_back(att);
+	return *this;
+}
+
+std::vector<nc_att_schema>& nc_schema::Atts(const std::string& theVar)
+{
+	if(theVar.empty())
+		return itsAtts;
+
+	for(nc_var_schema& var : itsVars)
+	{
+		if(var.itsName == theVar)
+			return var.itsAtts;
+	}
+
+	throw nc_error(NC_ENOTVAR);
+}
+
+} // end namespace
@@ -0,0 +1,359 @@
+#include "stats.h"
+#include "variable.h"
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <utility>
+
+namespace fminc4
+{
+
+namespace
+{
+
+struct counters
+{
+	nc_op_stats itsOps[kNcStatsOps];
+};
+
+typedef std::map<std::pair<std::string, std::string>, counters> counter_map; // by file and variable
+
+// Counters of one thread, locked by the thread while recording and by snapshots
+struct table
+{
+	std::mutex itsMutex;
+	counter_map itsCounters;
+};
+
+struct registry
+{
+	std::mutex itsMutex;
+	std::set<table*> itsTables;
+	counter_map itsRetired; // counters of threads that have exited
+};
+
+// Never destroyed, threads may exit after static destruction
+registry& Registry()
+{
+	static registry* ret = new registry;
+	return *ret;
+}
+
+void Merge(const counter_map& theSrc, counter_map& theDst)
+{
+	for(const auto& c : theSrc)
+	{
+		counters& dst = theDst[c.first];
+		for(size_t op = 0; op < kNcStatsOps; ++op)
+			dst.itsOps[op].Add(c.second.itsOps[op]);
+	}
+}
+
+// Table of the calling thread, registered on first use
+struct thread_table
+{
+	thread_table()
+	{
+		std::lock_guard<std::mutex> lock(Registry().itsMutex);
+		Registry().itsTables.insert(&itsTable);
+	}
+
+	~thread_table()
+	{
+		std::lock_guard<std::mutex> lock(Registry().itsMutex);
+		std::lock_guard<std::mutex> tableLock(itsTable.itsMutex);
+
+		Merge(itsTable.itsCounters, Registry().itsRetired);
+		Registry().itsTables.erase(&itsTable);
+	}
+
+	table itsTable;
+};
+
+const char* kOpNames[kNcStatsOps] = { "open", "create", "read", "write", "attribute", "metadata" };
+
+std::atomic<bool> instrument(false);
+thread_local nc_stats_scope* currentScope = nullptr;
+
+} // end namespace
+
+void nc_op_stats::Add(const nc_op_stats& theOther)
+{
+	itsCalls += theOther.itsCalls;
+	itsErrors += theOther.itsErrors;
+	itsBytes += theOther.itsBytes;
+	itsSeconds += theOther.itsSeconds;
+	itsLockWaitSeconds += theOther.itsLockWaitSeconds;
+
+	for(size_t i = 0; i < kNcLatencyBuckets; ++i)
+		itsLatency[i] += theOther.itsLatency[i];
+}
+
+void Instrument(bool theOn)
+{
+	instrument.store(theOn, std::memory_order_relaxed);
+}
+
+bool Instrument()
+{
+	return instrument.load(std::memory_order_relaxed);
+}
+
+nc_stats_scope::nc_stats_scope(NcStatsOp theOp, const std::string& theFile, const nc_var* theVar)
+	: itsActive(false), itsOp(theOp), itsFile(theFile), itsVar(theVar), itsBytes(0), itsFailed(false), itsExceptions(0), itsLockWait(0)
+{
+	if(currentScope || !instrument.load(std::memory_order_relaxed))
+		return;
+
+#if __cplusplus >= 201703L
+	itsExceptions = std::uncaught_exceptions();
+#endif
+
+	itsActive = true;
+	currentScope = this;
+	itsStart = std::chrono::steady_clock::now();
+}
+
+nc_stats_scope::~nc_stats_scope()
+{
+	if(!itsActive)
+		return;
+
+	const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - itsStart;
+#if __cplusplus >= 201703L
+	const bool error = itsFailed || std::uncaught_exceptions() > itsExceptions;
+#else
+	// a call made from a destructor during unwinding is counted as failed
+	const bool error = itsFailed || std::uncaught_exception();
+#endif
+
+	try
+	{
+		// name lookup may scan the file, still counted as part of this call
+		const std::string var = itsVar ? itsVar->Name() : std::string();
+		currentScope = nullptr;
+
+		const long long us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+		size_t bucket = 0;
+		while(bucket + 1 < kNcLatencyBuckets && us >= (1LL << bucket))
+			++bucket;
+
+		thread_local thread_table threadTable;
+		std::lock_guard<std::mutex> lock(threadTable.itsTable.itsMutex);
+
+		nc_op_stats& stats = threadTable.itsTable.itsCounters[std::make_pair(itsFile, var)].itsOps[itsOp];
+		stats.itsCalls++;
+		stats.itsErrors += error ? 1 : 0;
+		stats.itsBytes += itsBytes;
+		stats.itsSeconds += std::chrono::duration<double>(elapsed).count();
+		stats.itsLockWaitSeconds += std::chrono::duration<double>(itsLockWait).count();
+		stats.itsLatency[bucket]++;
+	}
+	catch(...)
+	{
+		// a destructor must not throw, call goes uncounted
+	}
+
+	currentScope = nullptr;
+}
+
+bool nc_stats_scope::Measuring()
+{
+	return currentScope != nullptr;
+}
+
+void nc_stats_scope::LockWait(std::chrono::steady_clock::duration theWait)
+{
+	if(currentScope)
+		currentScope->itsLockWait += theWait;
+}
+
+std::vector<nc_io_stats> IoStats()
+{
+	counter_map merged;
+	{
+		std::lock_guard<std::mutex> lock(Registry().itsMutex);
+		merged = Registry().itsRetired;
+
+		for(table* t : Registry().itsTables)
+		{
+			std::lock_guard<std::mutex> tableLock(t->itsMutex);
+			Merge(t->itsCounters, merged);
+		}
+	}
+
+	std::vector<nc_io_stats> ret;
+	ret.reserve(merged.size());
+
+	for(const auto& c : merged)
+	{
+		nc_io_stats stats;
+		stats.itsFile = c.first.first;
+		stats.itsVar = c.first.second;
+		for(size_t op = 0; op < kNcStatsOps; ++op)
+			stats.itsOps[op] = c.second.itsOps[op];
+
+		ret.push_back(stats);
+	}
+
+	return ret;
+}
+
+void ResetIoStats()
+{
+	std::lock_guard<std::mutex> lock(Registry().itsMutex);
+	Registry().itsRetired.clear();
+
+	for(table* t : Registry().itsTables)
+	{
+		std::lock_guard<std::mutex> tableLock(t->itsMutex);
+		t->itsCounters.clear();
+	}
+}
+
+// Quoted string contents: JSON escapes every control character, the Prometheus text format only knows newlines
+static std::string Escape(const std::string& theValue, bool theJson)
+{
+	std::string ret;
+	ret.reserve(theValue.size());
+
+	for(char c : theValue)
+	{
+		const unsigned char u = static_cast<unsigned char>(c);
+
+		if(c == '"' || c == '\\')
+		{
+			ret += '\\';
+			ret += c;
+		}
+		else if(c == '\n')
+			ret += "\\n";
+		else if(theJson && u < 0x20)
+		{
+			char buffer[8];
+			std::snprintf(buffer, sizeof(buffer), "\\u%04x", u);
+			ret += buffer;
+		}
+		else
+			ret += c;
+	}
+
+	return ret;
+}
+
+std::string IoStatsJson()
+{
+	std::ostringstream out;
+	out.precision(9);
+
+	out << "[";
+
+	const std::vector<nc_io_stats> stats = IoStats();
+	for(size_t i = 0; i < stats.size(); ++i)
+	{
+		out << (i > 0 ? "," : "") << "{\"file\":\"" << Escape(stats[i].itsFile, true) << "\",\"variable\":\"" << Escape(stats[i].itsVar, true) << "\",\"operations\":{";
+
+		bool first = true;
+		for(size_t op = 0; op < kNcStatsOps; ++op)
+		{
+			const nc_op_stats& s = stats[i].itsOps[op];
+			if(s.itsCalls == 0)
+				continue;
+
+			out << (first ? "" : ",") << "\"" << kOpNames[op] << "\":{\"calls\":" << s.itsCalls << ",\"errors\":" << s.itsErrors
+				<< ",\"bytes\":" << s.itsBytes << ",\"seconds\":" << s.itsSeconds << ",\"lock_wait_seconds\":" << s.itsLockWaitSeconds
+				<< ",\"latency_us\":[";
+
+			for(size_t b = 0; b < kNcLatencyBuckets; ++b)
+				out << (b > 0 ? "," : "") << s.itsLatency[b];
+
+			out << "]}";
+			first = false;
+		}
+
+		out << "}}";
+	}
+
+	out << "]";
+
+	return out.str();
+}
+
+std::string IoStatsPrometheus()
+{
+	std::ostringstream out;
+	out.precision(9);
+
+	const std::vector<nc_io_stats> stats = IoStats();
+
+	// one metric family at a time, as the format requires
+	const char* counters[] = { "fminc4_calls_total", "fminc4_errors_total", "fminc4_bytes_total", "fminc4_lock_wait_seconds_total" };
+
+	for(size_t m = 0; m < 4; ++m)
+	{
+		out << "# TYPE " << counters[m] << " counter\n";
+
+		for(const nc_io_stats& s : stats)
+		{
+			for(size_t op = 0; op < kNcStatsOps; ++op)
+			{
+				const nc_op_stats& o = s.itsOps[op];
+				if(o.itsCalls == 0)
+					continue;
+
+				out << counters[m] << "{file=\"" << Escape(s.itsFile, false) << "\",variable=\"" << Escape(s.itsVar, false) << "\",op=\"" << kOpNames[op] << "\"} ";
+
+				switch(m)
+				{
+					case 0:
+						out << o.itsCalls;
+						break;
+					case 1:
+						out << o.itsErrors;
+						break;
+					case 2:
+						out << o.itsBytes;
+						break;
+					default:
+						out << o.itsLockWaitSeconds;
+						break;
+				}
+
+				out << "\n";
+			}
+		}
+	}
+
+	out << "# TYPE fminc4_latency_seconds histogram\n";
+
+	for(const nc_io_stats& s : stats)
+	{
+		for(size_t op = 0; op < kNcStatsOps; ++op)
+		{
+			const nc_op_stats& o = s.itsOps[op];
+			if(o.itsCalls == 0)
+				continue;
+
+			const std::string labels = "file=\"" + Escape(s.itsFile, false) + "\",variable=\"" + Escape(s.itsVar, false) + "\",op=\"" + kOpNames[op] + "\"";
+
+			size_t cumulative = 0;
+			for(size_t b = 0; b + 1 < kNcLatencyBuckets; ++b)
+			{
+				cumulative += o.itsLatency[b];
+				out << "fminc4_latency_seconds_bucket{" << labels << ",le=\"" << static_cast<double>(1LL << b) * 1e-6 << "\"} " << cumulative << "\n";
+			}
+
+			out << "fminc4_latency_seconds_bucket{" << labels << ",le=\"+Inf\"} " << o.itsCalls << "\n";
+			out << "fminc4_latency_seconds_sum{" << labels << "} " << o.itsSeconds << "\n";
+			out << "fminc4_latency_seconds_count{" << labels << "} " << o.itsCalls << "\n";
+		}
+	}
+
+	return out.str();
+}
+
+} // end namespace
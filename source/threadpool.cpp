@@ -0,0 +1,101 @@
+#include "threadpool.h"
+#include <algorithm>
+
+namespace fminc4
+{
+
+std::mutex threadPoolMutex;
+std::shared_ptr<nc_thread_pool> threadPool;
+thread_local bool inWorker = false;
+
+nc_thread_pool::nc_thread_pool(size_t theThreads) : itsStop(false)
+{
+	theThreads = std::max<size_t>(theThreads, 1);
+	itsThreads.reserve(theThreads);
+
+	for(size_t i = 0; i < theThreads; ++i)
+		itsThreads.emplace_back(&nc_thread_pool::Run, this);
+}
+
+nc_thread_pool::~nc_thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(itsMutex);
+		itsStop = true;
+	}
+	itsWork.notify_all();
+
+	for(auto& t : itsThreads)
+		t.join();
+}
+
+std::future<void> nc_thread_pool::Submit(std::function<void()> theTask)
+{
+	// std::function must be copyable, packaged_task is not
+	auto task = std::make_shared<std::packaged_task<void()>>(theTask);
+	std::future<void> ret = task->get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(itsMutex);
+		itsTasks.emplace_back([task]{ (*task)(); });
+	}
+	itsWork.notify_one();
+
+	return ret;
+}
+
+size_t nc_thread_pool::Size() const
+{
+	return itsThreads.size();
+}
+
+bool nc_thread_pool::InWorker()
+{
+	return inWorker;
+}
+
+void nc_thread_pool::Run()
+{
+	inWorker = true;
+
+	std::unique_lock<std::mutex> lock(itsMutex);
+
+	while(true)
+	{
+		itsWork.wait(lock, [this]{ return itsStop || !itsTasks.empty(); });
+
+		if(itsTasks.empty())
+			return;
+
+		std::function<void()> task = std::move(itsTasks.front());
+		itsTasks.pop_front();
+
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
+
+std::shared_ptr<nc_thread_pool> ThreadPool()
+{
+	std::lock_guard<std::mutex> lock(threadPoolMutex);
+
+	if(!threadPool)
+		threadPool = std::make_shared<nc_thread_pool>(std::thread::hardware_concurrency());
+
+	return threadPool;
+}
+
+void ThreadPoolSize(size_t theThreads)
+{
+	std::shared_ptr<nc_thread_pool> pool = std::make_shared<nc_thread_pool>(theThreads);
+
+	{
+		std::lock_guard<std::mutex> lock(threadPoolMutex);
+		threadPool.swap(pool);
+	}
+
+	// old pool finishes its queued tasks once the last user releases it
+}
+
+} // end namespace
@@ -1,145 +1,1089 @@
 #include "variable.h"
 #include "dimension.h"
 #include "group.h"
+#include "metadata.h"
+#include "writequeue.h"
+#include "blockcache.h"
+#include "mapping.h"
+#include "hyperslab.h"
+#include "chunking.h"
+#include "chunkio.h"
+#include "attributes.h"
+#include "coordinates.h"
+#include "stats.h"
+#include "traits.h"
 #include <type_traits>
 #include <algorithm>
+#include <map>
+#include <numeric>
+#include <cstdint>
 
 namespace fminc4
 {
 
-nc_var::nc_var(int theNcId, int theVarId) : itsNcId(theNcId), itsVarId(theVarId)
+nc_var::nc_var(std::shared_ptr<nc_file> theFile, int theNcId, int theVarId) : itsFile(theFile), itsNcId(theNcId), itsVarId(theVarId)
 {
+	auto metadata = itsFile->Metadata();
+	itsLayout = itsFile->Layout(itsNcId, itsVarId, Info(*metadata));
+}
+
+nc_var::nc_var(std::shared_ptr<nc_file> theFile, int theNcId, int theVarId, const nc_var_info* theLayout)
+	: itsFile(theFile), itsNcId(theNcId), itsVarId(theVarId), itsLayout(theLayout)
+{
+}
+
+const nc_var_info& nc_var::Layout() const
+{
+	if(!itsFile || !itsLayout)
+		throw nc_error(NC_ENOTVAR);
+
+	return *itsLayout;
 }
 
 nc_type nc_var::Type() const
 {
-	nc_type varType;
-	nc_inq_vartype(itsNcId,itsVarId,&varType);
-	return varType;
+	return Layout().itsType;
+}
+
+std::string nc_var::Name() const
+{
+	return Layout().itsName;
+}
+
+const nc_var_info& nc_var::Info(const nc_metadata& theMetadata) const
+{
+	const nc_var_info* info = theMetadata.Var(itsNcId, itsVarId);
+	if(!info)
+		throw nc_error(NC_ENOTVAR);
+
+	return *info;
+}
+
+void nc_var::ChunkCache(size_t theSize, size_t theSlots, float thePreemption)
+{
+	auto lock = itsFile->Lock();
+
+	int status = nc_set_var_chunk_cache(itsNcId, itsVarId, theSize, theSlots, thePreemption);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+}
+
+void nc_var::ParAccess(NcParAccess theAccess)
+{
+	auto lock = itsFile->Lock();
+
+	int status = nc_var_par_access(itsNcId, itsVarId, theAccess);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+}
+
+template <typename T>
+bool nc_var::CachedRead(T* data, const std::vector<size_t>& start, const std::vector<size_t>& count, int& theStatus)
+{
+	nc_block_cache* cache = itsFile->BlockCache();
+	if(!cache)
+		return false;
+
+	if(Type() != nc_traits<T>::value)
+		return false;
+
+	nc_result<std::vector<size_t>> shape = TryShape();
+	if(!shape)
+	{
+		theStatus = shape.Status();
+		return true;
+	}
+
+	int status = cache->Read(itsNcId, itsVarId, shape.Value(), start, count, data);
+
+	// too large to be cached, read directly
+	if(status == NC_EINVAL)
+		return false;
+
+	theStatus = status;
+	return true;
+}
+
+template <typename T>
+bool nc_var::ChunkedRead(T* data, const std::vector<size_t>& shape, int& theStatus)
+{
+	if(!itsFile->itsOptions.itsParallelChunks || Type() != nc_traits<T>::value)
+		return false;
+
+	int status = ReadChunks(*itsFile, itsNcId, itsVarId, shape, sizeof(T), data);
+
+	// not stored in a way chunks can be decoded here, or not stored yet, read through the library
+	if(status == NC_EINVAL || status == NC_ENOTBUILT || status == NC_EINDEFINE)
+		return false;
+
+	theStatus = status;
+	return true;
+}
+
+template <typename T>
+bool nc_var::ChunkedWrite(const T* vals)
+{
+	if(!itsFile->itsOptions.itsParallelChunks || Type() != nc_traits<T>::value)
+		return false;
+
+	int status = WriteChunks(*itsFile, itsNcId, itsVarId, Shape(), sizeof(T), vals);
+
+	// datasets of new variables are stored once define mode ends, as a write through the library would end it
+	if(status == NC_EINDEFINE)
+	{
+		{
+			auto lock = itsFile->Lock();
+			status = nc_enddef(itsFile->itsNcId);
+		}
+
+		if(status == NC_NOERR)
+			status = WriteChunks(*itsFile, itsNcId, itsVarId, Shape(), sizeof(T), vals);
+		else if(status == NC_ENOTINDEFINE)
+			status = NC_EINVAL;
+	}
+
+	if(status == NC_EINVAL || status == NC_ENOTBUILT || status == NC_EINDEFINE)
+		return false;
+
+	Written();
+
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	return true;
+}
+
+void nc_var::Written()
+{
+	itsFile->Modified();
+
+	nc_block_cache* cache = itsFile->BlockCache();
+	if(cache)
+		cache->Erase(itsNcId, itsVarId);
+
+	itsFile->CoordCache().Erase(itsNcId, itsVarId);
+}
+
+static bool LittleEndian()
+{
+	const uint16_t one = 1;
+	return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+const void* nc_var::Mapped(size_t theBytes)
+{
+	nc_mapping* mapping = itsFile->itsMapping.get();
+	if(!mapping)
+		return nullptr;
+
+	std::string path;
+	{
+		auto lock = itsFile->Lock();
+
+		// classic format stores big endian data at offsets the library does not reveal
+		int format;
+		int status = nc_inq_format(itsNcId, &format);
+		if(status != NC_NOERR || (format != NC_FORMAT_NETCDF4 && format != NC_FORMAT_NETCDF4_CLASSIC))
+			return nullptr;
+
+		int storage;
+		status = nc_inq_var_chunking(itsNcId, itsVarId, &storage, NULL);
+		if(status != NC_NOERR || storage != NC_CONTIGUOUS)
+			return nullptr;
+
+		int endian;
+		status = nc_inq_var_endian(itsNcId, itsVarId, &endian);
+		if(status != NC_NOERR || (endian == NC_ENDIAN_LITTLE) != LittleEndian())
+			return nullptr;
+
+		size_t len;
+		status = nc_inq_grpname_full(itsNcId, &len, NULL);
+		if(status != NC_NOERR)
+			return nullptr;
+
+		std::vector<char> buffer(len + 1);
+		status = nc_inq_grpname_full(itsNcId, &len, buffer.data());
+		if(status != NC_NOERR)
+			return nullptr;
+
+		path.assign(buffer.data(), len);
+	}
+
+	if(path.empty() || path[path.size() - 1] != '/')
+		path += '/';
+	path += Name();
+
+	size_t offset;
+	if(mapping->Offset(path, itsFile->itsLockMode, offset) != NC_NOERR || offset > mapping->Size() || mapping->Size() - offset < theBytes)
+		return nullptr;
+
+	return static_cast<const unsigned char*>(mapping->Data()) + offset;
 }
 
 template <typename T>
 void nc_var::Write(const std::vector<T>& vals)
 {
-        // ensure thread safety
-        std::lock_guard<std::mutex> liblock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsWrite, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(vals.size() * sizeof(T));
+
+	if(vals.size() >= Length() && ChunkedWrite(vals.data()))
+		return;
+
+	int status;
+	{
+		// ensure thread safety
+		auto lock = itsFile->Lock();
+		status = nc_traits<T>::PutVar(itsNcId, itsVarId, vals.data());
+	}
+
+	Written();
 
-        int status = nc_put_var(itsNcId, itsVarId, vals.data());
 	if(status != NC_NOERR)
-		throw status;
+		throw nc_error(status);
 }
-template void nc_var::Write<float>(const std::vector<float>&);
-template void nc_var::Write<double>(const std::vector<double>&);
-template void nc_var::Write<short>(const std::vector<short>&);
-template void nc_var::Write<int>(const std::vector<int>&);
-template void nc_var::Write<uint64_t>(const std::vector<uint64_t>&);
+#define INSTANTIATE(T) template void nc_var::Write<T>(const std::vector<T>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
 
 template <typename T>
 void nc_var::Write(const std::vector<T>& vals, const std::vector<size_t>& start, const std::vector<size_t>& count)
 {
-        // ensure thread safety
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsWrite, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(vals.size() * sizeof(T));
+
+	int status;
+	{
+		// ensure thread safety
+		auto lock = itsFile->Lock();
+		status = nc_traits<T>::PutVara(itsNcId, itsVarId, start.data(), count.data(), vals.data());
+	}
+
+	Written();
 
-        int status = nc_put_vara(itsNcId, itsVarId, start.data(), count.data(), vals.data());
 	if(status != NC_NOERR)
-		throw status;
+		throw nc_error(status);
 }
-template void nc_var::Write<float>(const std::vector<float>&, const std::vector<size_t>&, const std::vector<size_t>&);
-template void nc_var::Write<double>(const std::vector<double>&, const std::vector<size_t>&, const std::vector<size_t>&);
-template void nc_var::Write<short>(const std::vector<short>&, const std::vector<size_t>&, const std::vector<size_t>&);
-template void nc_var::Write<int>(const std::vector<int>&, const std::vector<size_t>&, const std::vector<size_t>&);
-template void nc_var::Write<uint64_t>(const std::vector<uint64_t>&, const std::vector<size_t>&, const std::vector<size_t>&);
+#define INSTANTIATE(T) template void nc_var::Write<T>(const std::vector<T>&, const std::vector<size_t>&, const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
 
 template <typename T>
 void nc_var::Write(T value, const std::vector<size_t>& index)
 {
-        // ensure thread safety
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsWrite, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(sizeof(T));
 
-	int status = nc_put_var1(itsNcId, itsVarId, index.data(), &value);
-        if(status != NC_NOERR)
-		throw status;
+	int status;
+	{
+		// ensure thread safety
+		auto lock = itsFile->Lock();
+		status = nc_traits<T>::PutVar1(itsNcId, itsVarId, index.data(), &value);
+	}
+
+	Written();
+
+	if(status != NC_NOERR)
+		throw nc_error(status);
 }
-template void nc_var::Write<float>(float, const std::vector<size_t>&);
-template void nc_var::Write<double>(double, const std::vector<size_t>&);
-template void nc_var::Write<short>(short, const std::vector<size_t>&);
-template void nc_var::Write<int>(int, const std::vector<size_t>&);
-template void nc_var::Write<uint64_t>(uint64_t, const std::vector<size_t>&);
+#define INSTANTIATE(T) template void nc_var::Write<T>(T, const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
 
 template <typename T>
-std::vector<T> nc_var::Read()
+void nc_var::Write(const T* vals, size_t size)
 {
-	size_t size = 1;
-	for(auto x : GetDims())
-		size *= x.Size();
+	FMINC4_STATS_SCOPE(kNcStatsWrite, itsFile->itsPath, this);
 
-	std::vector<T> ret(size);
+	if(size < Length())
+		throw nc_error(NC_EINVAL);
 
-	int status = nc_get_var(itsNcId, itsVarId, ret.data());
-        if(status != NC_NOERR)
-                throw status;
+	FMINC4_STATS_BYTES(Length() * sizeof(T));
+
+	if(ChunkedWrite(vals))
+		return;
+
+	int status;
+	{
+		// ensure thread safety
+		auto lock = itsFile->Lock();
+		status = nc_traits<T>::PutVar(itsNcId, itsVarId, vals);
+	}
+
+	Written();
+
+	if(status != NC_NOERR)
+		throw nc_error(status);
+}
+#define INSTANTIATE(T) template void nc_var::Write<T>(const T*, size_t);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+void nc_var::Write(const T* vals, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count)
+{
+	FMINC4_STATS_SCOPE(kNcStatsWrite, itsFile->itsPath, this);
+
+	if(size < std::accumulate(count.begin(), count.end(), size_t(1), std::multiplies<size_t>()))
+		throw nc_error(NC_EINVAL);
+
+	FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+	int status;
+	{
+		// ensure thread safety
+		auto lock = itsFile->Lock();
+		status = nc_traits<T>::PutVara(itsNcId, itsVarId, start.data(), count.data(), vals);
+	}
+
+	Written();
+
+	if(status != NC_NOERR)
+		throw nc_error(status);
+}
+#define INSTANTIATE(T) template void nc_var::Write<T>(const T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+std::future<void> nc_var::WriteAsync(std::vector<T>&& vals, const std::vector<size_t>& start, const std::vector<size_t>& count)
+{
+	// buffer is read later by another thread, catch size mismatch here
+	if(vals.size() != std::accumulate(count.begin(), count.end(), size_t(1), std::multiplies<size_t>()))
+		throw nc_error(NC_EINVAL);
+
+	std::unique_ptr<nc_write_request> request(new nc_typed_write_request<T>(itsNcId, itsVarId, std::move(vals), start, count));
+	return itsFile->WriteQueue().Push(std::move(request));
+}
+#define INSTANTIATE(T) template std::future<void> nc_var::WriteAsync<T>(std::vector<T>&&, const std::vector<size_t>&, const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+nc_result<std::vector<T>> nc_var::TryRead()
+{
+	nc_result<std::vector<size_t>> shape = TryShape();
+	if(!shape)
+		return nc_failure(shape.Status());
+
+	std::vector<T> ret(Volume(shape.Value()));
+
+	nc_result<void> status = TryRead(ret.data(), ret.size());
+	if(!status)
+		return nc_failure(status.Status());
 
 	return ret;
 }
-template std::vector<float> nc_var::Read<float>();
-template std::vector<double> nc_var::Read<double>();
-template std::vector<short> nc_var::Read<short>();
-template std::vector<int> nc_var::Read<int>();
-template std::vector<uint64_t> nc_var::Read<uint64_t>();
+#define INSTANTIATE(T) template nc_result<std::vector<T>> nc_var::TryRead<T>();
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+std::vector<T> nc_var::Read()
+{
+	return TryRead<T>().Value();
+}
+#define INSTANTIATE(T) template std::vector<T> nc_var::Read<T>();
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+nc_result<void> nc_var::TryRead(T* data, size_t size)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+
+	nc_result<std::vector<size_t>> shape = TryShape();
+	int status = shape.Status();
+
+	if(status == NC_NOERR)
+	{
+		const size_t length = Volume(shape.Value());
+
+		if(size < length)
+			status = NC_EINVAL;
+		else
+		{
+			FMINC4_STATS_BYTES(length * sizeof(T));
+
+			if(!ChunkedRead(data, shape.Value(), status))
+			{
+				auto lock = itsFile->Lock();
+				status = nc_traits<T>::GetVar(itsNcId, itsVarId, data);
+			}
+		}
+	}
+
+	FMINC4_STATS_ERROR(status);
+
+	return status;
+}
+#define INSTANTIATE(T) template nc_result<void> nc_var::TryRead<T>(T*, size_t);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+void nc_var::Read(T* data, size_t size)
+{
+	TryRead(data, size).Value();
+}
+#define INSTANTIATE(T) template void nc_var::Read<T>(T*, size_t);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
 
 template <typename T>
 T nc_var::Read(const std::vector<size_t>& index)
 {
-	// thread safety required?
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(sizeof(T));
 
         T ret;
-        int status = nc_get_var1(itsNcId, itsVarId, index.data(), &ret);
+
+	int status = NC_NOERR;
+	if(CachedRead(&ret, index, std::vector<size_t>(index.size(), 1), status))
+	{
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		return ret;
+	}
+
+	// ensure thread safety
+	auto lock = itsFile->Lock();
+
+        status = nc_traits<T>::GetVar1(itsNcId, itsVarId, index.data(), &ret);
 	if(status != NC_NOERR)
-		throw status;
+		throw nc_error(status);
         return ret;
 }
-template float nc_var::Read<float>(const std::vector<size_t>&);
-template double nc_var::Read<double>(const std::vector<size_t>&);
-template short nc_var::Read<short>(const std::vector<size_t>&);
-template int nc_var::Read<int>(const std::vector<size_t>&);
-template uint64_t nc_var::Read<uint64_t>(const std::vector<size_t>&);
+#define INSTANTIATE(T) template T nc_var::Read<T>(const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
 
 template <typename T>
 std::vector<T> nc_var::Read(const std::vector<size_t>& start, const std::vector<size_t>& count)
 {
-	// thread safety required?
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+        std::vector<T> ret(std::accumulate(count.begin(), count.end(), size_t(1), std::multiplies<size_t>()));
+
+	Read(ret.data(), ret.size(), start, count);
 
-        std::vector<T> ret(std::accumulate(count.begin(), count.end(), 1.0, std::multiplies<T>()));
-        int status = nc_get_vara(itsNcId, itsVarId, start.data(), count.data(), ret.data());
-	if(status != NC_NOERR)
-		throw status;
         return ret;
 }
-template std::vector<float> nc_var::Read<float>(const std::vector<size_t>&, const std::vector<size_t>&);
-template std::vector<double> nc_var::Read<double>(const std::vector<size_t>&, const std::vector<size_t>&);
-template std::vector<short> nc_var::Read<short>(const std::vector<size_t>&, const std::vector<size_t>&);
-template std::vector<int> nc_var::Read<int>(const std::vector<size_t>&, const std::vector<size_t>&);
-template std::vector<uint64_t> nc_var::Read<uint64_t>(const std::vector<size_t>&, const std::vector<size_t>&);
+#define INSTANTIATE(T) template std::vector<T> nc_var::Read<T>(const std::vector<size_t>&, const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+nc_result<void> nc_var::TryRead(T* data, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+
+	int status = NC_NOERR;
+
+	if(size < Volume(count))
+		status = NC_EINVAL;
+	else
+	{
+		FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+		if(!CachedRead(data, start, count, status))
+		{
+			// ensure thread safety
+			auto lock = itsFile->Lock();
+			status = nc_traits<T>::GetVara(itsNcId, itsVarId, start.data(), count.data(), data);
+		}
+	}
+
+	FMINC4_STATS_ERROR(status);
+
+	return status;
+}
+#define INSTANTIATE(T) template nc_result<void> nc_var::TryRead<T>(T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+void nc_var::Read(T* data, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count)
+{
+	TryRead(data, size, start, count).Value();
+}
+#define INSTANTIATE(T) template void nc_var::Read<T>(T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+std::vector<T> nc_var::Read(const std::vector<size_t>& start, const std::vector<size_t>& count, const std::vector<ptrdiff_t>& stride)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+	std::vector<T> ret(Volume(count));
+
+	Read(ret.data(), ret.size(), start, count, stride);
+
+	return ret;
+}
+#define INSTANTIATE(T) template std::vector<T> nc_var::Read<T>(const std::vector<size_t>&, const std::vector<size_t>&, const std::vector<ptrdiff_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+void nc_var::Read(T* data, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count, const std::vector<ptrdiff_t>& stride)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+
+	if(size < Volume(count))
+		throw nc_error(NC_EINVAL);
+
+	FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+	// ensure thread safety
+	auto lock = itsFile->Lock();
+
+	int status = nc_traits<T>::GetVars(itsNcId, itsVarId, start.data(), count.data(), stride.data(), data);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+}
+#define INSTANTIATE(T) template void nc_var::Read<T>(T*, size_t, const std::vector<size_t>&, const std::vector<size_t>&, const std::vector<ptrdiff_t>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+// Coordinate variable of a dimension is the one dimensional variable named after it, searched from the group of
+// the variable outwards like the dimension itself
+nc_result<std::shared_ptr<const nc_coordinate>> nc_var::TryCoordinate(size_t theDim)
+{
+	if(!itsFile || !itsLayout)
+		return nc_failure(NC_ENOTVAR);
+
+	if(theDim >= itsLayout->itsDimIds.size())
+		return nc_failure(NC_EBADDIM);
+
+	nc_result<std::shared_ptr<const nc_metadata>> scanned = itsFile->TryMetadata();
+	if(!scanned)
+		return nc_failure(scanned.Status());
+
+	auto metadata = scanned.Value();
+
+	const int dimId = itsLayout->itsDimIds[theDim];
+	const nc_dim_info* dim = metadata->Dim(dimId);
+	if(!dim)
+		return nc_failure(NC_EBADDIM);
+
+	for(int groupId = itsNcId; metadata->Group(groupId); groupId = metadata->Group(groupId)->itsParentId)
+	{
+		const int varId = metadata->VarId(groupId, dim->itsName);
+		if(varId < 0)
+			continue;
+
+		const nc_var_info* info = metadata->Var(groupId, varId);
+		if(info->itsDimIds != std::vector<int>(1, dimId))
+			continue;
+
+		nc_var var(itsFile, groupId, varId, itsFile->Layout(groupId, varId, *info));
+
+		nc_result<std::vector<size_t>> shape = var.TryShape();
+		if(!shape)
+			return nc_failure(shape.Status());
+
+		// values of unlimited coordinates are read again once records were appended
+		std::shared_ptr<const nc_coordinate> ret = itsFile->CoordCache().Find(groupId, varId);
+		if(ret && ret->itsValues.size() == shape.Value()[0])
+			return ret;
+
+		nc_result<std::vector<double>> values = var.TryRead<double>();
+		if(!values)
+			return nc_failure(values.Status());
+
+		ret = std::make_shared<const nc_coordinate>(std::move(values.Value()));
+		itsFile->CoordCache().Insert(groupId, varId, ret);
+
+		return ret;
+	}
+
+	return std::shared_ptr<const nc_coordinate>();
+}
+
+std::shared_ptr<const nc_coordinate> nc_var::Coordinate(size_t theDim)
+{
+	return TryCoordinate(theDim).Value();
+}
+
+nc_result<void> nc_var::TryResolve(const nc_selection& theSelection, std::vector<size_t>& theStart, std::vector<size_t>& theCount)
+{
+	if(!itsFile || !itsLayout)
+		return nc_failure(NC_ENOTVAR);
+
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, this);
+
+	nc_result<std::vector<size_t>> shape = TryShape();
+	if(!shape)
+		return nc_failure(shape.Status());
+
+	theStart.assign(shape.Value().size(), 0);
+	theCount = shape.Value();
+
+	nc_result<std::shared_ptr<const nc_metadata>> scanned = itsFile->TryMetadata();
+	if(!scanned)
+		return nc_failure(scanned.Status());
+
+	auto metadata = scanned.Value();
+
+	int status = NC_NOERR;
+
+	for(const nc_selection::item& item : theSelection.itsItems)
+	{
+		// a dimension missing from the snapshot fails the selection like an unknown name
+		const nc_dim_info* dim = nullptr;
+		size_t d = 0;
+		for(; d < itsLayout->itsDimIds.size(); ++d)
+		{
+			dim = metadata->Dim(itsLayout->itsDimIds[d]);
+			if(!dim || dim->itsName == item.itsDim)
+				break;
+		}
+
+		if(d == itsLayout->itsDimIds.size() || !dim)
+		{
+			status = NC_EBADDIM;
+			break;
+		}
+
+		const size_t length = shape.Value()[d];
+
+		if(item.itsKind == nc_selection::kIndex)
+		{
+			if(item.itsStart > length || item.itsCount > length - item.itsStart)
+			{
+				status = NC_EINVALCOORDS;
+				break;
+			}
+
+			theStart[d] = item.itsStart;
+			theCount[d] = item.itsCount;
+			continue;
+		}
+
+		nc_result<std::shared_ptr<const nc_coordinate>> coordinate = TryCoordinate(d);
+		if(!coordinate || !coordinate.Value())
+		{
+			status = coordinate ? NC_ENOTVAR : coordinate.Status();
+			break;
+		}
+
+		if(item.itsKind == nc_selection::kNearest)
+		{
+			status = coordinate.Value()->Nearest(item.itsMin, theStart[d]);
+			theCount[d] = 1;
+
+			if(status == NC_NOERR && theStart[d] >= length)
+				status = NC_EINVALCOORDS;
+		}
+		else
+		{
+			status = coordinate.Value()->Range(item.itsMin, item.itsMax, theStart[d], theCount[d]);
+
+			// records may have been appended to the variable after the coordinate
+			theStart[d] = std::min(theStart[d], length);
+			theCount[d] = std::min(theCount[d], length - theStart[d]);
+		}
+
+		if(status != NC_NOERR)
+			break;
+	}
+
+	FMINC4_STATS_ERROR(status);
+
+	if(status != NC_NOERR)
+		return nc_failure(status);
+
+	return nc_result<void>();
+}
+
+void nc_var::Resolve(const nc_selection& theSelection, std::vector<size_t>& theStart, std::vector<size_t>& theCount)
+{
+	TryResolve(theSelection, theStart, theCount).Value();
+}
+
+template <typename T>
+nc_result<std::vector<T>> nc_var::TryRead(const nc_selection& theSelection)
+{
+	std::vector<size_t> start, count;
+
+	nc_result<void> status = TryResolve(theSelection, start, count);
+	if(!status)
+		return nc_failure(status.Status());
+
+	std::vector<T> ret(Volume(count));
+
+	// nothing to read, start of an empty range may be past the end
+	if(ret.empty())
+		return ret;
+
+	status = TryRead(ret.data(), ret.size(), start, count);
+	if(!status)
+		return nc_failure(status.Status());
+
+	return ret;
+}
+
+template <typename T>
+std::vector<T> nc_var::Read(const nc_selection& theSelection)
+{
+	return TryRead<T>(theSelection).Value();
+}
+#define INSTANTIATE(T) \
+	template nc_result<std::vector<T>> nc_var::TryRead<T>(const nc_selection&); \
+	template std::vector<T> nc_var::Read<T>(const nc_selection&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+template <typename T>
+std::vector<T> nc_var::Gather(const std::vector<std::vector<size_t>>& indices)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(indices.size() * sizeof(T));
+
+	std::vector<T> ret(indices.size());
+
+	Gather(ret.data(), ret.size(), indices);
+
+	return ret;
+}
+#define INSTANTIATE(T) template std::vector<T> nc_var::Gather<T>(const std::vector<std::vector<size_t>>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+/*
+ * Points are grouped by the storage block (chunk) they fall in and the bounding box of each group is read with one call.
+ * A chunk is decoded as a whole anyway, so reading a box inside it costs about the same as reading a single point.
+ */
+
+template <typename T>
+void nc_var::Gather(T* data, size_t size, const std::vector<std::vector<size_t>>& indices)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+
+	if(size < indices.size())
+		throw nc_error(NC_EINVAL);
+
+	FMINC4_STATS_BYTES(indices.size() * sizeof(T));
+
+	if(indices.empty())
+		return;
+
+	const std::vector<size_t> shape = Shape();
+	const size_t n = shape.size();
+
+	std::vector<size_t> block;
+	{
+		auto lock = itsFile->Lock();
+
+		int status = StorageBlock(itsNcId, itsVarId, shape, sizeof(T), block);
+		if(status != NC_NOERR)
+			throw nc_error(status);
+	}
+
+	// positions of points by block index, ordered so that blocks are read in storage order
+	std::map<std::vector<size_t>, std::vector<size_t>> groups;
+	std::vector<size_t> key(n);
+
+	for(size_t i = 0; i < indices.size(); ++i)
+	{
+		const std::vector<size_t>& index = indices[i];
+		if(index.size() != n)
+			throw nc_error(NC_EINVALCOORDS);
+
+		for(size_t d = 0; d < n; ++d)
+		{
+			if(index[d] >= shape[d])
+				throw nc_error(NC_EINVALCOORDS);
+
+			key[d] = index[d] / block[d];
+		}
+
+		groups[key].push_back(i);
+	}
+
+	std::vector<size_t> start(n), count(n);
+	std::vector<T> buffer;
+
+	for(const auto& group : groups)
+	{
+		const std::vector<size_t>& points = group.second;
+
+		start = indices[points.front()];
+		std::vector<size_t> last = start;
+
+		for(size_t i : points)
+		{
+			for(size_t d = 0; d < n; ++d)
+			{
+				start[d] = std::min(start[d], indices[i][d]);
+				last[d] = std::max(last[d], indices[i][d]);
+			}
+		}
+
+		for(size_t d = 0; d < n; ++d)
+			count[d] = last[d] - start[d] + 1;
+
+		buffer.resize(Volume(count));
+
+		int status;
+		{
+			auto lock = itsFile->Lock();
+			status = nc_traits<T>::GetVara(itsNcId, itsVarId, start.data(), count.data(), buffer.data());
+		}
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		for(size_t i : points)
+		{
+			size_t offset = 0;
+			for(size_t d = 0; d < n; ++d)
+				offset = offset * count[d] + (indices[i][d] - start[d]);
+
+			data[i] = buffer[offset];
+		}
+	}
+}
+#define INSTANTIATE(T) template void nc_var::Gather<T>(T*, size_t, const std::vector<std::vector<size_t>>&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
+
+nc_packing nc_var::Packing()
+{
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, this);
+
+	auto metadata = itsFile->Metadata();
+	const nc_var_info& info = Info(*metadata);
+
+	nc_packing ret;
+	bool fillValue = false; // _FillValue wins over missing_value
+
+	auto lock = itsFile->Lock();
+
+	for(const nc_att_info& att : info.itsAtts)
+	{
+		if(att.itsLength == 0 || att.itsType == NC_CHAR || att.itsType == NC_STRING)
+			continue;
+
+		double* value;
+		if(att.itsName == "scale_factor")
+			value = &ret.itsScale;
+		else if(att.itsName == "add_offset")
+			value = &ret.itsOffset;
+		else if(att.itsName == "_FillValue" || (att.itsName == "missing_value" && !fillValue))
+			value = &ret.itsFill;
+		else
+			continue;
+
+		// missing_value may list several values, the first one is used
+		std::vector<double> values(att.itsLength);
+		int status = nc_traits<double>::GetAtt(itsNcId, itsVarId, att.itsName.c_str(), values.data());
+		if(status != NC_NOERR)
+			throw nc_error(status);
+
+		*value = values[0];
+
+		if(value == &ret.itsFill)
+		{
+			ret.itsHasFill = true;
+			fillValue = fillValue || att.itsName == "_FillValue";
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Packed data is read in its own type to a scratch buffer and unpacked from there to the caller's buffer.
+ */
+
+template <typename P, typename T>
+static void ReadAndUnpack(nc_var& theVar, T* data, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count, const nc_packing& packing)
+{
+	std::vector<P> packed(size);
+	theVar.Read(packed.data(), size, start, count);
+	Unpack(packed.data(), size, data, packing);
+}
+
+template <typename T>
+std::vector<T> nc_var::ReadUnpacked()
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(Length() * sizeof(T));
+
+	const std::vector<size_t> count = Shape();
+	std::vector<T> ret(Volume(count));
+
+	ReadUnpacked(ret.data(), ret.size(), std::vector<size_t>(count.size(), 0), count);
+
+	return ret;
+}
+template std::vector<float> nc_var::ReadUnpacked<float>();
+template std::vector<double> nc_var::ReadUnpacked<double>();
+
+template <typename T>
+std::vector<T> nc_var::ReadUnpacked(const std::vector<size_t>& start, const std::vector<size_t>& count)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+	std::vector<T> ret(Volume(count));
+
+	ReadUnpacked(ret.data(), ret.size(), start, count);
+
+	return ret;
+}
+template std::vector<float> nc_var::ReadUnpacked<float>(const std::vector<size_t>&, const std::vector<size_t>&);
+template std::vector<double> nc_var::ReadUnpacked<double>(const std::vector<size_t>&, const std::vector<size_t>&);
+
+template <typename T>
+void nc_var::ReadUnpacked(T* data, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count)
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+	static_assert(std::is_floating_point<T>::value, "unpacked values are float or double");
+
+	const size_t n = Volume(count);
+	if(size < n)
+		throw nc_error(NC_EINVAL);
+
+	const nc_packing packing = Packing();
+
+	switch(Type())
+	{
+		case NC_BYTE:
+			return ReadAndUnpack<int8_t>(*this, data, n, start, count, packing);
+		case NC_UBYTE:
+			return ReadAndUnpack<uint8_t>(*this, data, n, start, count, packing);
+		case NC_SHORT:
+			return ReadAndUnpack<short>(*this, data, n, start, count, packing);
+		case NC_USHORT:
+			return ReadAndUnpack<unsigned short>(*this, data, n, start, count, packing);
+		case NC_INT:
+			return ReadAndUnpack<int>(*this, data, n, start, count, packing);
+		case NC_UINT:
+			return ReadAndUnpack<unsigned int>(*this, data, n, start, count, packing);
+		case NC_FLOAT:
+		case NC_DOUBLE:
+			// not packed as such but may still have fill value, scale and offset
+			Read(data, n, start, count);
+			UnpackScalar(data, n, data, packing);
+			return;
+		default:
+			throw nc_error(NC_EBADTYPE);
+	}
+}
+template void nc_var::ReadUnpacked<float>(float*, size_t, const std::vector<size_t>&, const std::vector<size_t>&);
+template void nc_var::ReadUnpacked<double>(double*, size_t, const std::vector<size_t>&, const std::vector<size_t>&);
+
+template <typename P, typename T>
+static void PackAndWrite(nc_var& theVar, const T* data, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count, const nc_packing& packing)
+{
+	std::vector<P> packed(size);
+
+	int status = Pack(data, size, packed.data(), packing);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	theVar.Write(packed.data(), size, start, count);
+}
+
+template <typename T>
+void nc_var::WritePacked(const std::vector<T>& vals)
+{
+	FMINC4_STATS_SCOPE(kNcStatsWrite, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(vals.size() * sizeof(T));
+
+	const std::vector<size_t> count = Shape();
+
+	WritePacked(vals.data(), vals.size(), std::vector<size_t>(count.size(), 0), count);
+}
+template void nc_var::WritePacked<float>(const std::vector<float>&);
+template void nc_var::WritePacked<double>(const std::vector<double>&);
+
+template <typename T>
+void nc_var::WritePacked(const T* vals, size_t size, const std::vector<size_t>& start, const std::vector<size_t>& count)
+{
+	FMINC4_STATS_SCOPE(kNcStatsWrite, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(Volume(count) * sizeof(T));
+
+	static_assert(std::is_floating_point<T>::value, "unpacked values are float or double");
+
+	const size_t n = Volume(count);
+	if(size < n)
+		throw nc_error(NC_EINVAL);
+
+	const nc_packing packing = Packing();
+
+	switch(Type())
+	{
+		case NC_BYTE:
+			return PackAndWrite<int8_t>(*this, vals, n, start, count, packing);
+		case NC_UBYTE:
+			return PackAndWrite<uint8_t>(*this, vals, n, start, count, packing);
+		case NC_SHORT:
+			return PackAndWrite<short>(*this, vals, n, start, count, packing);
+		case NC_USHORT:
+			return PackAndWrite<unsigned short>(*this, vals, n, start, count, packing);
+		case NC_INT:
+			return PackAndWrite<int>(*this, vals, n, start, count, packing);
+		case NC_UINT:
+			return PackAndWrite<unsigned int>(*this, vals, n, start, count, packing);
+		default:
+			throw nc_error(NC_EBADTYPE);
+	}
+}
+template void nc_var::WritePacked<float>(const float*, size_t, const std::vector<size_t>&, const std::vector<size_t>&);
+template void nc_var::WritePacked<double>(const double*, size_t, const std::vector<size_t>&, const std::vector<size_t>&);
+
+template <typename T>
+nc_view<T> nc_var::View()
+{
+	FMINC4_STATS_SCOPE(kNcStatsRead, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(Length() * sizeof(T));
+
+	const size_t size = Length();
+
+	if(itsFile->itsMapping && Type() == nc_traits<T>::value)
+	{
+		const void* data = Mapped(size * sizeof(T));
+
+		// data is used in place only if suitably aligned for T
+		if(data && reinterpret_cast<uintptr_t>(data) % alignof(T) == 0)
+		{
+			// shares ownership of the mapping
+			std::shared_ptr<const T> ptr(itsFile->itsMapping, static_cast<const T*>(data));
+			return nc_view<T>(ptr, size, true);
+		}
+	}
+
+	auto copy = std::make_shared<std::vector<T>>(size);
+	Read(copy->data(), size);
+
+	return nc_view<T>(std::shared_ptr<const T>(copy, copy->data()), size, false);
+}
+#define INSTANTIATE(T) template nc_view<T> nc_var::View<T>();
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+#undef INSTANTIATE
 
 // Attributes
 std::vector<std::tuple<std::string, nc_type, size_t>> nc_var::ListAtts() const
 {
-        int natts;
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, this);
 
-        nc_inq_natts(itsNcId, &natts);
-	nc_inq_var(itsNcId,itsVarId,NULL,NULL,NULL,NULL,&natts);
+	auto metadata = itsFile->Metadata();
+	const nc_var_info& info = Info(*metadata);
 
         std::vector<std::tuple<std::string, nc_type, size_t>> ret;
+	ret.reserve(info.itsAtts.size());
 
-        for (int i = 0; i<natts; ++i)
+        for (const nc_att_info& att : info.itsAtts)
         {
-                char recname[NC_MAX_NAME+1];
-		nc_type type;
-		size_t size;
-		
-                nc_inq_attname(itsNcId, itsVarId, i, recname);
-		nc_inq_att(itsNcId, itsVarId, recname, &type, &size) ;	
-                ret.emplace_back(recname, type, size);
+                ret.emplace_back(att.itsName, att.itsType, att.itsLength);
         }
 
         return ret;
@@ -147,80 +1091,131 @@ std::vector<std::tuple<std::string, nc_type, size_t>> nc_var::ListAtts() const
 
 void nc_var::AddTextAtt(const std::string& attName, const std::string& attValue)
 {
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(attValue.size());
+
+        auto lock = itsFile->Lock();
 
         int status = nc_put_att_text(itsNcId, itsVarId, attName.c_str(), attValue.length(),attValue.c_str());
         if(status != NC_NOERR)
-                throw status;
+                throw nc_error(status);
+
+	itsFile->Invalidate();
 }
 
-template <typename T>
-std::vector<T> nc_var::GetAtt(const std::string& name)
+void nc_var::PutAtt(const std::string& name, nc_type type, size_t theLength, size_t theSize, const void* theValues)
 {
-        // thread safety required?
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, this);
+	FMINC4_STATS_BYTES(theLength * theSize);
+
+	auto lock = itsFile->Lock();
 
-        size_t attlen;
-        nc_inq_attlen(itsNcId, itsVarId, name.c_str(), &attlen);
+	int status = nc_put_att(itsNcId, itsVarId, name.c_str(), type, theLength, theValues);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	itsFile->Invalidate();
+}
 
-        std::vector<T> ret(attlen);
+void nc_var::AddAtt(const std::string& name, const std::vector<std::string>& values)
+{
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, this);
 
-        nc_get_att(itsNcId, itsVarId, name.c_str(), ret.data());
+	nc_att_schema att;
+	att.itsName = name;
+	att.itsType = NC_STRING;
+	att.itsLength = values.size();
+	att.itsStrings = values;
 
-        return ret;
+	auto lock = itsFile->Lock();
+
+	int status = WriteAtt(itsNcId, itsVarId, att);
+	if(status != NC_NOERR)
+		throw nc_error(status);
+
+	itsFile->Invalidate();
 }
-template std::vector<double> nc_var::GetAtt<double>(const std::string&);
 
-template <>
-std::vector<std::string> nc_var::GetAtt(const std::string& name)
+// Values are converted from the type of the attribute, see ConvertAtt
+template <typename T>
+nc_result<std::vector<T>> nc_var::TryGetAtt(const std::string& name)
 {
-        std::lock_guard<std::mutex> lock(netcdfLibMutex);
-        nc_type theType;
-        int status = nc_inq_atttype(itsNcId, itsVarId, name.c_str(), &theType);
-        switch(theType)
-        {
-                case NC_CHAR :  {
-                                        size_t attlen;
-                                        status = nc_inq_attlen(itsNcId, itsVarId, name.c_str(), &attlen);
-                                        char att[attlen];
-                                        status = nc_get_att(itsNcId, itsVarId, name.c_str(), att);
-                                        return std::vector<std::string>{std::string(att).substr(0,attlen)};
-                                }
-                case NC_STRING :{
-                                        std::vector<char*> chars = GetAtt<char*>(name);
-                                        std::vector<std::string> ret;
-                                        for(auto x : chars)
-                                        {
-                                                ret.emplace_back(x);
-                                        }
-                                        return ret;
-                                }
-                default:
-                        throw status;
-        }
+	FMINC4_STATS_SCOPE(kNcStatsAttribute, itsFile->itsPath, this);
+
+	nc_result<std::vector<T>> ret = AttValues<T>(*itsFile, itsNcId, itsVarId, name);
+	FMINC4_STATS_ERROR(ret.Status());
+
+	return ret;
+}
+
+template <typename T>
+std::vector<T> nc_var::GetAtt(const std::string& name)
+{
+	return TryGetAtt<T>(name).Value();
 }
-template std::vector<std::string> nc_var::GetAtt<std::string>(const std::string&);
+#define INSTANTIATE(T) \
+	template nc_result<std::vector<T>> nc_var::TryGetAtt<T>(const std::string&); \
+	template std::vector<T> nc_var::GetAtt<T>(const std::string&);
+FMINC4_ELEMENT_TYPES(INSTANTIATE)
+INSTANTIATE(std::string)
+#undef INSTANTIATE
 
 // Dimensions
-std::vector<nc_dim> nc_var::GetDims()
+size_t nc_var::Length()
 {
+	size_t size = 1;
+	for(auto x : Shape())
+		size *= x;
 
-        int ndims;
-        int status = nc_inq_varndims(itsNcId, itsVarId, &ndims);
-        if(status != NC_NOERR)
-                throw status;
+	return size;
+}
 
-        std::vector<int> dimids(ndims);
+nc_result<std::vector<size_t>> nc_var::TryShape()
+{
+	if(!itsFile || !itsLayout)
+		return nc_failure(NC_ENOTVAR);
 
-        status = nc_inq_vardimid(itsNcId, itsVarId, dimids.data());
-        if(status != NC_NOERR)
-                throw status;
+	FMINC4_STATS_SCOPE(kNcStatsMetadata, itsFile->itsPath, this);
+
+	std::vector<size_t> ret = itsLayout->itsLengths;
+
+	std::unique_lock<std::mutex> lock;
+
+	for(size_t i = 0; i < ret.size(); ++i)
+	{
+		if(ret[i] > 0)
+			continue;
+
+		// unlimited dimensions grow with every write
+		if(!lock.owns_lock())
+			lock = itsFile->Lock();
+
+		int status = nc_inq_dimlen(itsNcId, itsLayout->itsDimIds[i], &ret[i]);
+		if(status != NC_NOERR)
+		{
+			FMINC4_STATS_ERROR(status);
+			return nc_failure(status);
+		}
+	}
+
+	return ret;
+}
+
+std::vector<size_t> nc_var::Shape()
+{
+	return TryShape().Value();
+}
+
+std::vector<nc_dim> nc_var::GetDims()
+{
+	const nc_var_info& layout = Layout();
 
 	std::vector<nc_dim> ret;
-	ret.reserve(ndims);
+	ret.reserve(layout.itsDimIds.size());
+
+	for(size_t i = 0; i < layout.itsDimIds.size(); ++i)
+		ret.emplace_back(itsFile, itsNcId, layout.itsDimIds[i], layout.itsLengths[i]);
 
-        for(auto x : dimids)
-		ret.emplace_back(itsNcId,x);
 	return ret;
 }
 
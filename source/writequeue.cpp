@@ -0,0 +1,147 @@
+#include "writequeue.h"
+#include "fminc4.h"
+#include "blockcache.h"
+#include "coordinates.h"
+
+namespace fminc4
+{
+
+// Merged requests are not grown beyond this, one library call per this many bytes is cheap enough
+const size_t kMaxMergeBytes = 64 * 1024 * 1024;
+
+nc_write_request::nc_write_request(int theNcId, int theVarId, const std::vector<size_t>& theStart, const std::vector<size_t>& theCount)
+	: itsNcId(theNcId), itsVarId(theVarId), itsStart(theStart), itsCount(theCount)
+{
+}
+
+/*
+ * Two hyperslabs are contiguous when they differ in exactly one dimension k where the second starts right where the first ends,
+ * all dimensions before k are of length one and all dimensions after k are identical. Then the row-major buffers can simply be concatenated.
+ */
+
+bool nc_write_request::Merge(nc_write_request& theNext)
+{
+	if(theNext.itsNcId != itsNcId || theNext.itsVarId != itsVarId || theNext.itsStart.size() != itsStart.size())
+		return false;
+
+	if(Size() + theNext.Size() > kMaxMergeBytes)
+		return false;
+
+	size_t k = 0;
+	while(k < itsStart.size() && itsStart[k] == theNext.itsStart[k] && itsCount[k] == theNext.itsCount[k])
+		++k;
+
+	if(k == itsStart.size() || theNext.itsStart[k] != itsStart[k] + itsCount[k])
+		return false;
+
+	for(size_t i = 0; i < k; ++i)
+	{
+		if(itsCount[i] != 1)
+			return false;
+	}
+
+	for(size_t i = k + 1; i < itsStart.size(); ++i)
+	{
+		if(itsStart[i] != theNext.itsStart[i] || itsCount[i] != theNext.itsCount[i])
+			return false;
+	}
+
+	if(!Append(theNext))
+		return false;
+
+	itsCount[k] += theNext.itsCount[k];
+	for(auto& p : theNext.itsPromises)
+		itsPromises.push_back(std::move(p));
+	theNext.itsPromises.clear();
+
+	return true;
+}
+
+nc_write_queue::nc_write_queue(nc_file& theFile) : itsFile(theFile), itsBusy(false), itsStop(false)
+{
+	itsThread = std::thread(&nc_write_queue::Run, this);
+}
+
+nc_write_queue::~nc_write_queue()
+{
+	{
+		std::lock_guard<std::mutex> lock(itsMutex);
+		itsStop = true;
+	}
+	itsWork.notify_one();
+	itsThread.join();
+}
+
+std::future<void> nc_write_queue::Push(std::unique_ptr<nc_write_request> theRequest)
+{
+	theRequest->itsPromises.resize(1);
+	std::future<void> ret = theRequest->itsPromises.front().get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(itsMutex);
+		itsQueue.push_back(std::move(theRequest));
+	}
+	itsWork.notify_one();
+
+	return ret;
+}
+
+void nc_write_queue::Drain()
+{
+	std::unique_lock<std::mutex> lock(itsMutex);
+	itsIdle.wait(lock, [this]{ return itsQueue.empty() && !itsBusy; });
+}
+
+void nc_write_queue::Run()
+{
+	std::unique_lock<std::mutex> lock(itsMutex);
+
+	while(true)
+	{
+		itsWork.wait(lock, [this]{ return itsStop || !itsQueue.empty(); });
+
+		if(itsQueue.empty())
+			return; // stop requested and everything written
+
+		// take everything queued so far and let producers continue
+		std::deque<std::unique_ptr<nc_write_request>> batch;
+		batch.swap(itsQueue);
+		itsBusy = true;
+		lock.unlock();
+
+		while(!batch.empty())
+		{
+			std::unique_ptr<nc_write_request> request = std::move(batch.front());
+			batch.pop_front();
+
+			while(!batch.empty() && request->Merge(*batch.front()))
+				batch.pop_front();
+
+			int status;
+			{
+				auto liblock = itsFile.Lock();
+				status = request->Put();
+			}
+
+			if(itsFile.BlockCache())
+				itsFile.BlockCache()->Erase(request->itsNcId, request->itsVarId);
+
+			itsFile.CoordCache().Erase(request->itsNcId, request->itsVarId);
+
+			for(auto& p : request->itsPromises)
+			{
+				if(status == NC_NOERR)
+					p.set_value();
+				else
+					p.set_exception(std::make_exception_ptr(nc_error(status)));
+			}
+		}
+
+		lock.lock();
+		itsBusy = false;
+		if(itsQueue.empty())
+			itsIdle.notify_all();
+	}
+}
+
+} // end namespace